@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include "bench.h"
+#include "number.h"
+#define ll long long
+
+using namespace std;
+
+static bool value(const string& arg, const string& name, string& v) {
+    if(arg.compare(0, name.size() + 1, name + "=") != 0)
+        return false;
+    v = arg.substr(name.size() + 1);
+    return true;
+}
+
+static void usage(const char* name) {
+    cerr << "usage: " << name << " [--reps=N] [--warmup=N] [--csv=PATH] [--filter=TEXT]" << endl;
+    exit(1);
+}
+
+// v as a number of at least least into out, or usage
+static void count(const char* name, const string& arg, const string& v, int least, int& out) {
+    if(!number(v, out)) {
+        cerr << "not a number in range in " << arg << endl;
+        usage(name);
+    }
+    out = max(least, out);
+}
+
+BenchRunner::BenchRunner(string suite, int argc, char* argv[]) : suite(suite) {
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i], v;
+        if(value(arg, "--reps", v))
+            count(argv[0], arg, v, 1, reps);
+        else if(value(arg, "--warmup", v))
+            count(argv[0], arg, v, 0, warmup);
+        else if(value(arg, "--csv", v))
+            csvFile = v;
+        else if(value(arg, "--filter", v))
+            filter = v;
+        else if(arg.compare(0, 2, "--") == 0) {
+            cerr << "unknown option " << arg << endl;
+            usage(argv[0]);
+        }
+        else
+            arguments.push_back(arg);
+    }
+}
+
+bool BenchRunner::selected(const string& name) const {
+    return filter == "" || name.find(filter) != string::npos;
+}
+
+void BenchRunner::record(string name, string variant, string unit, vector<double>& samples, ll extra) {
+    sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    BenchResult r;
+    r.suite = suite;
+    r.name = name;
+    r.variant = variant;
+    r.unit = unit;
+    r.reps = n;
+    r.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    /*
+        Ranks n/2 -+ 0.98 sqrt(n) bound the median with ~95% confidence
+        whatever the distribution of the samples.
+    */
+    double spread = 0.98 * sqrt((double) n);
+    long lowRank = (long) floor(n / 2.0 - spread);
+    long highRank = (long) ceil(n / 2.0 + spread);
+    r.low = samples[max(0L, lowRank)];
+    r.high = samples[min((long) n - 1, highRank)];
+    double sum = 0;
+    for(double s : samples)
+        sum += s;
+    r.mean = sum / n;
+    r.min = samples.front();
+    r.max = samples.back();
+    r.extra = extra;
+    results.push_back(r);
+    printf("%-28s %-10s %12.3f %-2s  [%.3f, %.3f]\n", name.c_str(), variant.c_str(),
+           r.median, unit.c_str(), r.low, r.high);
+    fflush(stdout);
+}
+
+void BenchRunner::report() {
+    if(csvFile == "")
+        return;
+    FILE* out = fopen(csvFile.c_str(), "a");
+    if(out == nullptr) {
+        cerr << "cannot write " << csvFile << endl;
+        return;
+    }
+    if(ftell(out) == 0)
+        fprintf(out, "suite,benchmark,variant,unit,reps,median,ci_low,ci_high,mean,min,max,extra\n");
+    for(BenchResult& r : results)
+        fprintf(out, "%s,%s,%s,%s,%d,%.6g,%.6g,%.6g,%.6g,%.6g,%.6g,%lld\n", r.suite.c_str(),
+                r.name.c_str(), r.variant.c_str(), r.unit.c_str(), r.reps, r.median, r.low,
+                r.high, r.mean, r.min, r.max, r.extra);
+    fclose(out);
+}
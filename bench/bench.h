@@ -0,0 +1,80 @@
+#ifndef BENCH_HEADER
+#define BENCH_HEADER
+
+#include <chrono>
+#include <string>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Shared harness of micro_bench and macro_bench. Every benchmark body is
+    run warmup times untimed and then reps times timed. The report is the
+    median time per operation with a distribution-free 95% confidence
+    interval for the median (order statistics, so it is the min/max range
+    for few repetitions), plus mean, min and max.
+
+    Command line, common to both programs:
+
+        --reps=N        timed repetitions (default 5)
+        --warmup=N      untimed repetitions before them (default 1)
+        --csv=PATH      append results to PATH, with a header if it is empty
+        --filter=TEXT   only run benchmarks whose name contains TEXT
+
+    The CSV has one row per benchmark and is meant to be diffed across
+    builds: suite,benchmark,variant,unit,reps,median,ci_low,ci_high,mean,
+    min,max,extra. extra is what the body returned: the simulated cycle
+    count of a macro run, which has to stay the same across builds, or a
+    checksum that keeps a microbenchmark from being optimised away.
+*/
+
+struct BenchResult {
+    string suite, name, variant, unit;
+    int reps;
+    double median, low, high, mean, min, max;
+    ll extra;
+};
+
+class BenchRunner {
+public:
+    BenchRunner(string suite, int argc, char* argv[]);
+
+    bool selected(const string& name) const;
+
+    /*
+        Times body(), which performs ops operations, and records the time
+        per operation in unit (ns or ms). body may return a value that goes
+        to the extra column.
+    */
+    template<class F>
+    void run(string name, string variant, double ops, string unit, F body) {
+        if(!selected(name))
+            return;
+        double scale = unit == "ms" ? 1e3 : unit == "s" ? 1.0 : 1e9;
+        ll extra = 0;
+        for(int i = 0; i < warmup; i++)
+            extra = body();
+        vector<double> samples;
+        for(int i = 0; i < reps; i++) {
+            auto start = chrono::steady_clock::now();
+            extra = body();
+            chrono::duration<double> d = chrono::steady_clock::now() - start;
+            samples.push_back(d.count() * scale / ops);
+        }
+        record(name, variant, unit, samples, extra);
+    }
+
+    // appends the results to the CSV file; each result is printed as it is recorded
+    void report();
+
+    string suite;
+    int warmup = 1, reps = 5;
+    string csvFile, filter;
+    vector<string> arguments;      // non-option arguments
+    vector<BenchResult> results;
+
+private:
+    void record(string name, string variant, string unit, vector<double>& samples, ll extra);
+};
+
+#endif
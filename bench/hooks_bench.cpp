@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "assembler.h"
+#include "memory.h"
+#include "simulator.h"
+#define ll long long
+using namespace std;
+
+/*
+    Checks that memory hooks cost nothing when none are registered:
+
+        hooks_bench [words] [repetitions]
+
+    array_sum over words words runs on each pipeline through the library
+    three times: with default options, which builds ProcSim<NoHooks>, with
+    --count-accesses, which builds ProcSim<MemoryHooks> that only counts,
+    and with a watchpoint no access hits, which also takes the dispatch
+    path. The delta of each to NoHooks is printed per simulated cycle.
+    The two instantiations are laid out differently, which alone moves
+    either one by up to about 6% on the same host, so the exit status is 1
+    only if NoHooks is more than 10% slower than counting with MemoryHooks.
+*/
+
+static const char* ARRAY_SUM =
+    "lui $t2 %d\nlui $t5 4\nlui $t6 1\n"
+    "srl $t2 $t2 16\nsrl $t5 $t5 16\nsrl $t6 $t6 16\n"
+    "beq $t2 $t3 5\nlw $t1 0($t4)\nadd $t0 $t0 $t1\n"
+    "add $t4 $t4 $t5\nadd $t3 $t3 $t6\nj 6\nsw $t0 0($t4)\n";
+
+// the time of one full run, in ns per simulated cycle
+static double nsPerCycle(CoreFactory pipeline, const Options& options, const vector<ll>& program,
+        shared_ptr<const MemoryImage> memory) {
+    Simulator sim(pipeline, options);
+    sim.load(program, memory);
+    auto start = chrono::steady_clock::now();
+    ll cycles = sim.run();
+    chrono::duration<double, nano> d = chrono::steady_clock::now() - start;
+    return d.count() / cycles;
+}
+
+int main(int argc, char* argv[]) {
+    int words = argc > 1 ? stoi(argv[1]) : 50000;
+    int reps = argc > 2 ? stoi(argv[2]) : 7;
+
+    char source[512];
+    snprintf(source, sizeof(source), ARRAY_SUM, words);
+    vector<ll> program;
+    string error;
+    if(!assemble(source, program, error)) {
+        fprintf(stderr, "array_sum: %s", error.c_str());
+        return 2;
+    }
+    vector<ll> initial(words);
+    mt19937 random(1);
+    for(ll& w : initial)
+        w = random() % 11;
+    auto memory = make_shared<const MemoryImage>(initial.data(), initial.size());
+
+    Options none;
+    Options counting;
+    counting.countAccesses = true;
+    Options watching;
+    watching.watchpoints.push_back({-8, -4});   // never hit
+
+    const pair<const char*, CoreFactory> pipelines[] = {
+        {"proc_sim1", newProcSim1}, {"proc_sim2", newProcSim2}, {"proc_sim3", newProcSim3}};
+    const char* names[] = {"NoHooks", "MemoryHooks, counting", "MemoryHooks, watch"};
+    const Options* configs[] = {&none, &counting, &watching};
+    bool costly = false;
+    for(const auto& [name, pipeline] : pipelines) {
+        // the configurations take turns so that drift of the host hits all alike
+        double best[3] = {1e30, 1e30, 1e30};
+        for(int r = 0; r < reps; r++)
+            for(int c = 0; c < 3; c++)
+                best[c] = min(best[c], nsPerCycle(pipeline, *configs[c], program, memory));
+        printf("%s, array_sum over %d words\n", name, words);
+        printf("    %-22s %8.3f ns/cycle\n", names[0], best[0]);
+        for(int c = 1; c < 3; c++)
+            printf("    %-22s %8.3f ns/cycle %+6.1f%%\n", names[c], best[c], 100 * (best[c] / best[0] - 1));
+        costly |= best[0] > best[1] * 1.10;
+    }
+    return costly ? 1 : 0;
+}
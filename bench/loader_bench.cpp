@@ -0,0 +1,64 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include "memory.h"
+#define ll long long
+using namespace std;
+
+/*
+    Measures the text loaders in MB/s:
+
+        loader_bench [lines] [repetitions]
+
+    Writes a synthetic memory file ("pos-val" lines) and instruction file of
+    the given number of lines to /tmp and times Memory and InstructionMemory
+    construction on them. The best of the repetitions is reported.
+*/
+
+static double bestSeconds(int reps, void (*load)(const string&), const string& file) {
+    double best = 1e30;
+    for(int r = 0; r < reps; r++) {
+        auto start = chrono::steady_clock::now();
+        load(file);
+        chrono::duration<double> d = chrono::steady_clock::now() - start;
+        best = min(best, d.count());
+    }
+    return best;
+}
+
+static void loadMemory(const string& file) {
+    Memory MEM(file);
+}
+
+static void loadInstructions(const string& file) {
+    InstructionMemory IMEM(file);
+}
+
+static void report(string name, const string& file, double seconds) {
+    ifstream f (file, ios::binary | ios::ate);
+    double mb = f.tellg() / 1e6;
+    printf("%-20s %8.2f MB %9.4f s %9.1f MB/s\n", name.c_str(), mb, seconds, mb / seconds);
+}
+
+int main(int argc, char* argv[]) {
+    ll lines = argc > 1 ? stoll(argv[1]) : 2000000;
+    int reps = argc > 2 ? stoi(argv[2]) : 5;
+    string memFile = "/tmp/loader_bench_mem", instrFile = "/tmp/loader_bench_instr";
+
+    mt19937_64 rng(1);
+    {
+        ofstream mem (memFile), instr (instrFile);
+        for(ll i = 0; i < lines; i++) {
+            mem << i % MEMORY_SIZE << "-" << (ll) (rng() % 1000000) << "\n";
+            instr << (rng() & 0xffffffffULL) << "\n";
+        }
+    }
+
+    report("memory text", memFile, bestSeconds(reps, loadMemory, memFile));
+    report("instruction text", instrFile, bestSeconds(reps, loadInstructions, instrFile));
+    remove(memFile.c_str());
+    remove(instrFile.c_str());
+}
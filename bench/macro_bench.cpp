@@ -0,0 +1,127 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "assembler.h"
+#include "bench.h"
+#define ll long long
+using namespace std;
+
+/*
+    Full simulator runs, one process per repetition as checker.py runs them:
+
+        macro_bench [SIMDIR] [--reps=N] [--warmup=N] [--csv=PATH] [--filter=TEXT]
+
+    Every workload runs on SIMDIR/proc_sim1..3 (default bin/bench, the -O2
+    build of `make bench`). Workloads are the hard tests and array_sum_large,
+    array_sum over 50000 words, which is written to SIMDIR/work. Programs
+    are assembled once, to decimal words as checker.py runs them.
+
+    The time is per run in ms and includes loading and the dump, what a user
+    of the simulator waits for. extra is the simulated cycle count; for
+    proc_sim1 and proc_sim2 it has to be the same in every build, proc_sim3
+    stalls at random.
+
+    Run from the top of the repository.
+*/
+
+extern char** environ;
+
+struct Workload {
+    string name, src, mem;
+};
+
+static Workload arraySumLarge(const string& dir, int n) {
+    mkdir(dir.c_str(), 0755);
+    ofstream src (dir + "/src");
+    src << "lui $t2 " << n << "\nlui $t5 4\nlui $t6 1\n"
+        << "srl $t2 $t2 16\nsrl $t5 $t5 16\nsrl $t6 $t6 16\n"
+        << "beq $t2 $t3 5\nlw $t1 0($t4)\nadd $t0 $t0 $t1\n"
+        << "add $t4 $t4 $t5\nadd $t3 $t3 $t6\nj 6\nsw $t0 0($t4)\n";
+    ofstream mem (dir + "/mem");
+    mt19937 random(1);
+    for(int i = 0; i < n; i++)
+        mem << i << "-" << random() % 11 << "\n";
+    return {"array_sum_large", dir + "/src", dir + "/mem"};
+}
+
+static bool assembleFile(const string& src, const string& program) {
+    ifstream in (src);
+    stringstream source;
+    source << in.rdbuf();
+    vector<ll> words;
+    string error;
+    if(!in || !assemble(source.str(), words, error)) {
+        cerr << src << ": " << error;
+        return false;
+    }
+    ofstream out (program);
+    for(ll w : words)
+        out << w << "\n";
+    return (bool) out;
+}
+
+// runs sim on the workload with stdout in out and returns the simulated cycles
+static ll simulate(const string& sim, const string& program, const string& mem, const string& out) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    char* argv[] = {(char*) sim.c_str(), (char*) program.c_str(), (char*) mem.c_str(), nullptr};
+    pid_t pid;
+    int status = -1;
+    if(posix_spawn(&pid, sim.c_str(), &actions, nullptr, argv, environ) == 0)
+        waitpid(pid, &status, 0);
+    posix_spawn_file_actions_destroy(&actions);
+    if(status != 0) {
+        cerr << sim << " failed on " << program << endl;
+        exit(1);
+    }
+    ifstream result (out);
+    string label;
+    ll cycles = -1;
+    result >> label >> cycles;
+    return cycles;
+}
+
+int main(int argc, char* argv[]) {
+    BenchRunner bench("macro", argc, argv);
+    string simDir = bench.arguments.empty() ? "bin/bench" : bench.arguments[0];
+    string work = simDir + "/work";
+    mkdir(work.c_str(), 0755);
+
+    vector<Workload> workloads = {
+        {"array_sum", "tests/hard/array_sum/src", "tests/hard/array_sum/mem"},
+        {"sel_sort", "tests/hard/sel_sort/src", "tests/hard/sel_sort/mem"},
+    };
+    if(bench.selected("array_sum_large"))
+        workloads.push_back(arraySumLarge(work + "/array_sum_large", 50000));
+
+    for(Workload& w : workloads) {
+        if(!bench.selected(w.name))
+            continue;
+        string program = work + "/" + w.name + ".prog";
+        if(!assembleFile(w.src, program)) {
+            cerr << "cannot assemble " << w.src << endl;
+            return 1;
+        }
+        for(int n = 1; n <= 3; n++) {
+            string sim = simDir + "/proc_sim" + to_string(n);
+            string out = work + "/" + w.name + ".out";
+            bench.run(w.name, "proc_sim" + to_string(n), 1, "ms", [&]() {
+                return simulate(sim, program, w.mem, out);
+            });
+        }
+    }
+
+    bench.report();
+    return 0;
+}
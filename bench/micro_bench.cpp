@@ -0,0 +1,148 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "instruction.h"
+#include "memory.h"
+#define ll long long
+using namespace std;
+
+/*
+    Microbenchmarks of the pieces every simulated cycle is made of:
+
+        micro_bench [--reps=N] [--warmup=N] [--csv=PATH] [--filter=TEXT]
+
+    decode          classify and split one instruction word
+    hazard          load-use hazard and forwarding checks for one pair
+    pipeline_cycle  the decoding work of one clock edge of proc_sim2,
+                    i.e. what every stage asks of its latch
+    memory_load     one data memory read, sequential and random
+    fetch           one instruction memory read
+
+    The instruction mix is that of the hard tests: mostly R-type, loads,
+    stores and branches, with some jumps.
+*/
+
+static ll rtype(int rs, int rt, int rd, int shamt, int funct) {
+    return ((ll) rs << 21) | ((ll) rt << 16) | ((ll) rd << 11) | (shamt << 6) | funct;
+}
+
+static ll itype(int op, int rs, int rt, int imm) {
+    return ((ll) op << 26) | ((ll) rs << 21) | ((ll) rt << 16) | (imm & 0xffff);
+}
+
+static vector<ll> instructionMix(size_t n) {
+    mt19937 random(1);
+    vector<ll> words;
+    for(size_t i = 0; i < n; i++) {
+        int rs = random() % 32, rt = random() % 32, rd = random() % 32;
+        switch(random() % 10) {
+        case 0: case 1: words.push_back(rtype(rs, rt, rd, 0, 0x20)); break;    // add
+        case 2: words.push_back(rtype(rs, rt, rd, 0, 0x22)); break;            // sub
+        case 3: words.push_back(rtype(0, rt, rd, 16, 0x02)); break;            // srl
+        case 4: case 5: words.push_back(itype(0x23, rs, rt, 4 * (random() % 64))); break;   // lw
+        case 6: words.push_back(itype(0x2b, rs, rt, 4 * (random() % 64))); break;           // sw
+        case 7: words.push_back(itype(random() % 2 ? 0x04 : 0x05, rs, rt, 5)); break;       // beq, bne
+        case 8: words.push_back(((ll) 0x02 << 26) | (random() % 64)); break;   // j
+        default: words.push_back(0); break;                                     // noop
+        }
+    }
+    return words;
+}
+
+static ll decode(const vector<ll>& words) {
+    ll sum = 0;
+    for(ll w : words) {
+        if(isRType(w))
+            sum += getOperation(w) + getRD(w);
+        else if(isLoad(w) || isStore(w))
+            sum += getRT(w) + getWriteOffset(w);
+        else if(isBranch(w))
+            sum += getBranchOffset(w);
+        else if(isJump(w) || isJAL(w))
+            sum += getJumpOffset(w);
+        else if(isJR(w))
+            sum += getRS(w);
+        sum += getRS(w);
+    }
+    return sum;
+}
+
+static ll hazards(const vector<ll>& words) {
+    ll sum = 0;
+    for(size_t i = 1; i < words.size(); i++) {
+        ll consumer = words[i], producer = words[i - 1];
+        if(isLoad(producer) && hazardExists(consumer, producer))
+            sum++;
+        int rs = getRS(consumer), rt = getRT(consumer);
+        sum += (writes(producer, rs) && reads(consumer, rs)) + (writes(producer, rt) && reads(consumer, rt));
+    }
+    return sum;
+}
+
+// the latch decoding of one cycle of proc_sim2, with the words of
+// four consecutive instructions standing in for IFID, IDEX, EXMEM and MEMWB
+static ll pipelineCycles(const vector<ll>& words) {
+    ll sum = 0;
+    for(size_t i = 3; i < words.size(); i++) {
+        ll ifid = words[i], idex = words[i - 1], exmem = words[i - 2], memwb = words[i - 3];
+        sum += isBranch(ifid) || isBranch(idex);
+        sum += (isLoad(idex) || isLUI(idex)) && hazardExists(ifid, idex);
+        sum += getJumpOffset(ifid) + toDecimal(toBinary(ifid), 6, 11);
+        if(isRType(exmem))
+            sum += getRD(exmem);
+        else if(isLoad(exmem) || isLUI(exmem))
+            sum += getRT(exmem);
+        if(isRType(idex))
+            sum += getOperation(idex) + toDecimal(toBinary(idex), 21, 26);
+        else if(isLoad(idex) || isStore(idex))
+            sum += getWriteOffset(idex);
+        else if(isBranch(idex))
+            sum += isBEQ(idex) + isBNE(idex) + getBranchOffset(idex);
+        int rs = getRS(ifid), rt = getRT(ifid);
+        sum += writes(exmem, rs) && reads(idex, rs);
+        sum += writes(memwb, rt) && reads(idex, rt);
+        sum += isJump(ifid) + isJAL(ifid) + isJR(ifid);
+        sum += isRType(memwb) || isLoad(memwb) || isLUI(memwb);
+        sum += isStore(exmem);
+    }
+    return sum;
+}
+
+int main(int argc, char* argv[]) {
+    BenchRunner bench("micro", argc, argv);
+    vector<ll> words = instructionMix(100000);
+
+    bench.run("decode", "", words.size(), "ns", [&]() { return decode(words); });
+    bench.run("hazard", "", words.size() - 1, "ns", [&]() { return hazards(words); });
+    bench.run("pipeline_cycle", "proc_sim2", words.size() - 3, "ns", [&]() { return pipelineCycles(words); });
+
+    Memory MEM("/dev/null");
+    const ll loads = 10000000;
+    bench.run("memory_load", "sequential", loads, "ns", [&]() {
+        ll sum = 0;
+        for(ll i = 0; i < loads; i++)
+            sum += MEM.memory[i % MEM.size];
+        return sum;
+    });
+    bench.run("memory_load", "random", loads, "ns", [&]() {
+        ll sum = 0;
+        size_t index = 0;
+        for(ll i = 0; i < loads; i++) {
+            index = (index * 1103515245 + 12345) % MEM.size;
+            sum += MEM.memory[index];
+        }
+        return sum;
+    });
+
+    InstructionMemory IMEM("/dev/null");
+    bench.run("fetch", "", loads, "ns", [&]() {
+        ll sum = 0;
+        for(ll PC = 0; PC < 4 * loads; PC += 4)
+            sum += IMEM.imem[(PC / 4) % IMEM.imem.size()];
+        return sum;
+    });
+
+    bench.report();
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "assembler.h"
+#define ll long long
+
+using namespace std;
+
+static const char* registerNames[32] = {
+    "$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+    "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"
+};
+
+// one instruction between the two passes
+struct Statement {
+    int line;
+    vector<string> tokens;
+};
+
+static bool isNumber(const string& text) {
+    if(text.empty())
+        return false;
+    char* end = nullptr;
+    strtoll(text.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+static int reg(const string& name) {
+    for(int i = 0; i < 32; i++)
+        if(name == registerNames[i])
+            return i;
+    if(name.size() > 1 && name[0] == '$' && isNumber(name.substr(1))) {
+        int n = atoi(name.c_str() + 1);
+        if(n >= 0 && n < 32)
+            return n;
+    }
+    throw runtime_error("unknown register " + name);
+}
+
+// value must fit in width bits, signed or unsigned; negative values wrap
+// to two's complement in the field, as in TestGenerator
+static ll immediate(const string& text, int width, bool allowNegative = true) {
+    if(!isNumber(text))
+        throw runtime_error("expected a number, got " + text);
+    ll value = strtoll(text.c_str(), nullptr, 10);
+    ll low = allowNegative ? -(1LL << (width - 1)) : 0;
+    if(value < low || value >= (1LL << width))
+        throw runtime_error(text + " does not fit in " + to_string(width) + " bits");
+    return value & ((1LL << width) - 1);
+}
+
+static ll rtype(int rs, int rt, int rd, ll shamt, int funct) {
+    return ((ll) rs << 21) | ((ll) rt << 16) | ((ll) rd << 11) | (shamt << 6) | funct;
+}
+
+static ll itype(int op, int rs, int rt, ll field) {
+    return ((ll) op << 26) | ((ll) rs << 21) | ((ll) rt << 16) | field;
+}
+
+class Encoder {
+public:
+    Encoder(const Statement& s, int index, const map<string, int>& labels)
+        : t(s.tokens), index(index), labels(labels) {}
+
+    ll encode() {
+        const string& op = t[0];
+        static const struct { const char* name; int funct; } arithmetic[] = {
+            {"add", 0x20}, {"sub", 0x22}, {"and", 0x24}, {"or", 0x25}, {"slt", 0x2a}
+        };
+        for(auto& a : arithmetic)
+            if(op == a.name) {
+                operands(3);
+                return rtype(reg(t[2]), reg(t[3]), reg(t[1]), 0, a.funct);
+            }
+        if(op == "sll" || op == "srl") {
+            operands(3);
+            return rtype(0, reg(t[2]), reg(t[1]), immediate(t[3], 5, false), op == "sll" ? 0x00 : 0x02);
+        }
+        if(op == "lw" || op == "sw") {
+            operands(2);
+            return memoryOperand(op == "lw" ? 0x23 : 0x2b, reg(t[1]), t[2]);
+        }
+        if(op == "j" || op == "jal") {
+            operands(1);
+            return ((ll) (op == "j" ? 0x02 : 0x03) << 26) | jumpTarget(t[1]);
+        }
+        if(op == "beq" || op == "bne" || op == "blez" || op == "bgtz") {
+            operands(3);
+            int code = op == "beq" ? 0x04 : op == "bne" ? 0x05 : op == "blez" ? 0x06 : 0x07;
+            return itype(code, reg(t[1]), reg(t[2]), branchOffset(t[3]));
+        }
+        if(op == "jr") {
+            operands(1);
+            return rtype(reg(t[1]), 0, 0, 0, 0x08);
+        }
+        if(op == "lui") {
+            operands(2);
+            return itype(0x0f, 0, reg(t[1]), immediate(t[2], 16));
+        }
+        if(op == "ori") {
+            operands(3);
+            return itype(0x0d, reg(t[2]), reg(t[1]), immediate(t[3], 16));
+        }
+        throw runtime_error("unknown instruction " + op);
+    }
+
+private:
+    void operands(size_t n) {
+        if(t.size() - 1 != n)
+            throw runtime_error(t[0] + " takes " + to_string(n) + " operands, got " + to_string(t.size() - 1));
+    }
+
+    // "offset(base)" of lw and sw
+    ll memoryOperand(int op, int rt, const string& operand) {
+        size_t open = operand.find('('), close = operand.find(')');
+        if(open == string::npos || close != operand.size() - 1 || close < open)
+            throw runtime_error("expected offset(base), got " + operand);
+        string offset = operand.substr(0, open);
+        return itype(op, reg(operand.substr(open + 1, close - open - 1)), rt,
+                     offset.empty() ? 0 : immediate(offset, 16));
+    }
+
+    int label(const string& name) {
+        auto it = labels.find(name);
+        if(it == labels.end())
+            throw runtime_error("undefined label " + name);
+        return it->second;
+    }
+
+    ll jumpTarget(const string& operand) {
+        if(isNumber(operand))
+            return immediate(operand, 26, false);
+        return label(operand);
+    }
+
+    ll branchOffset(const string& operand) {
+        if(isNumber(operand))
+            return immediate(operand, 16);
+        int offset = label(operand) - (index + 1);
+        if(offset < 0)
+            throw runtime_error("branch to " + operand + " goes backward; the pipelines only branch forward, use j");
+        return immediate(to_string(offset), 16, false);
+    }
+
+    const vector<string>& t;
+    int index;
+    const map<string, int>& labels;
+};
+
+static bool validLabel(const string& name) {
+    if(name.empty() || isdigit((unsigned char) name[0]))
+        return false;
+    for(char c : name)
+        if(!isalnum((unsigned char) c) && c != '_' && c != '.')
+            return false;
+    return true;
+}
+
+Assembly assembleSource(const string& source) {
+    Assembly a;
+    vector<Statement> statements;
+
+    // first pass: strip comments, split operands, collect labels
+    istringstream lines (source);
+    string text;
+    for(int line = 1; getline(lines, text); line++) {
+        text = text.substr(0, text.find('#'));
+        for(char& c : text)
+            if(c == ',' || c == '\t' || c == '\r')
+                c = ' ';
+        istringstream fields (text);
+        vector<string> tokens;
+        for(string field; fields >> field; )
+            tokens.push_back(field);
+
+        while(!tokens.empty() && tokens[0].back() == ':') {
+            string name = tokens[0].substr(0, tokens[0].size() - 1);
+            if(!validLabel(name))
+                a.errors.push_back({line, "invalid label " + tokens[0]});
+            else if(a.labels.count(name))
+                a.errors.push_back({line, "label " + name + " defined twice"});
+            else
+                a.labels[name] = statements.size();
+            tokens.erase(tokens.begin());
+        }
+        if(!tokens.empty())
+            statements.push_back({line, tokens});
+    }
+
+    // second pass: encode, now that every label is known
+    for(size_t i = 0; i < statements.size(); i++) {
+        try {
+            a.words.push_back(Encoder(statements[i], i, a.labels).encode());
+            a.lines.push_back(statements[i].line);
+        }
+        catch(const runtime_error& e) {
+            a.errors.push_back({statements[i].line, e.what()});
+        }
+    }
+    return a;
+}
+
+string Assembly::report(const string& name) const {
+    string out;
+    for(const AssemblyError& e : errors)
+        out += name + ":" + to_string(e.line) + ": " + e.message + "\n";
+    return out;
+}
+
+bool assemble(const string& source, vector<ll>& words, string& error) {
+    Assembly a = assembleSource(source);
+    if(!a.ok()) {
+        error = "";
+        for(const AssemblyError& e : a.errors)
+            error += "line " + to_string(e.line) + ": " + e.message + "\n";
+        return false;
+    }
+    words.insert(words.end(), a.words.begin(), a.words.end());
+    return true;
+}
+
+bool isAssemblyFile(const string& file) {
+    for(string extension : {".s", ".asm"})
+        if(file.size() > extension.size()
+                && file.compare(file.size() - extension.size(), extension.size(), extension) == 0)
+            return true;
+    return false;
+}
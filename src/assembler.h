@@ -0,0 +1,53 @@
+#ifndef ASSEMBLER_HEADER
+#define ASSEMBLER_HEADER
+
+#include <map>
+#include <string>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Assembler for the instruction set of the pipelines. It replaces
+    util/TestGenerator.java, which is kept as the reference for the source
+    format: every TestGenerator source assembles to the same words. On top
+    of that it accepts
+
+        loop:                   labels, alone or before an instruction
+        j loop                  labels as jump targets and branch targets
+        beq $t0 $t1 done        (branches must go forward, as the pipelines
+                                treat the offset as unsigned)
+        add $t0, $t1, $8        commas, and registers by number
+        # comment               comments to the end of the line
+
+    Numeric targets keep their TestGenerator meaning: instruction index for
+    j and jal, instructions after the next one for branches.
+
+    Words are emitted into memory, ready for InstructionMemory; nothing is
+    written to disk. All errors are collected, each with its source line.
+*/
+
+struct AssemblyError {
+    int line;
+    string message;
+};
+
+class Assembly {
+public:
+    vector<ll> words;
+    vector<int> lines;              // source line of each word
+    map<string, int> labels;        // instruction index of each label
+    vector<AssemblyError> errors;
+
+    bool ok() const { return errors.empty(); }
+    // "name:line: message" per error
+    string report(const string& name) const;
+};
+
+Assembly assembleSource(const string& source);
+// for callers that only want the words: false and the report on error
+bool assemble(const string& source, vector<ll>& words, string& error);
+// whether file is assembly source by its extension (.s or .asm)
+bool isAssemblyFile(const string& file);
+
+#endif
@@ -0,0 +1,44 @@
+#include <cstdio>
+#include <iostream>
+#include "assembler.h"
+#include "textload.h"
+#define ll long long
+
+using namespace std;
+
+/*
+    Command line front end of the assembler, a drop-in for TestGenerator:
+
+        assembler <source> <output>
+
+    writes one decimal word per line, the format InstructionMemory reads.
+    output may be - for stdout. Errors go to stderr as source:line: message
+    and nothing is written.
+*/
+int main(int argc, char* argv[]) {
+    if(argc != 3) {
+        cerr << "usage: " << argv[0] << " <source> <output|->" << endl;
+        return 1;
+    }
+    string source;
+    if(!readWholeFile(argv[1], source)) {
+        cerr << "cannot read " << argv[1] << endl;
+        return 1;
+    }
+    Assembly a = assembleSource(source);
+    if(!a.ok()) {
+        cerr << a.report(argv[1]);
+        return 1;
+    }
+    string out = argv[2];
+    FILE* f = out == "-" ? stdout : fopen(out.c_str(), "w");
+    if(f == nullptr) {
+        cerr << "cannot write " << out << endl;
+        return 1;
+    }
+    for(ll w : a.words)
+        fprintf(f, "%lld\n", w);
+    if(f != stdout)
+        fclose(f);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include "asyncload.h"
+#include "textload.h"
+#define ll long long
+
+using namespace std;
+
+AsyncMemoryLoad::AsyncMemoryLoad(Memory& MEM, string file) : MEM(MEM) {
+    loader = thread(&AsyncMemoryLoad::load, this, file);
+}
+
+AsyncMemoryLoad::~AsyncMemoryLoad() {
+    ready();
+}
+
+void AsyncMemoryLoad::ready() {
+    if(loader.joinable())
+        loader.join();
+}
+
+void AsyncMemoryLoad::load(string file) {
+    string buffer;
+    if(readWholeFile(file, buffer))
+        parseMemory(buffer, MEM.memory, MEM.size);
+}
@@ -0,0 +1,41 @@
+#ifndef ASYNCLOAD_HEADER
+#define ASYNCLOAD_HEADER
+
+#include <string>
+#include <thread>
+#include "memory.h"
+#define ll long long
+using namespace std;
+
+/*
+    Loads a text memory file ("pos-val" lines) into a Memory on a
+    background thread, so that reading and parsing it overlaps with loading
+    the program and building the pipeline. The run waits for it in ready()
+    before its first cycle.
+
+    No page can be handed out before the whole file is parsed, since a later
+    line may still change any page, so serving faults page by page (with
+    userfaultfd) would block every access until the same point anyway.
+
+    Binary images need none of this: their data segments are mapped and
+    the kernel faults their pages in on first access. Executables are
+    copied in before the run, as they are read without parsing.
+*/
+class AsyncMemoryLoad {
+public:
+    // MEM has to be freshly allocated and untouched
+    AsyncMemoryLoad(Memory& MEM, string file);
+    ~AsyncMemoryLoad();
+    AsyncMemoryLoad(const AsyncMemoryLoad&) = delete;
+    AsyncMemoryLoad& operator=(const AsyncMemoryLoad&) = delete;
+
+    // returns once every word is in place
+    void ready();
+
+private:
+    void load(string file);
+    Memory& MEM;
+    thread loader;
+};
+
+#endif
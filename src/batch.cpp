@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+#include "batch.h"
+#include "decoupled.h"
+#include "instruction.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#define ll long long
+
+using namespace std;
+
+// the register-register operations as the kernels know them
+enum LaneOp {LANE_ADD, LANE_SUB, LANE_AND, LANE_OR, LANE_SLT, LANE_SLL, LANE_SRL, LANE_ZERO};
+
+// d[i] = a[i] op b[i] for i < n, b[i] shifted by shamt for the shifts
+typedef void (*LaneKernel)(int op, ll* d, const ll* a, const ll* b, int shamt, size_t n);
+
+static inline ll laneOp(int op, ll a, ll b, int shamt) {
+    switch(op) {
+    case LANE_ADD: return a + b;
+    case LANE_SUB: return a - b;
+    case LANE_AND: return a & b;
+    case LANE_OR:  return a | b;
+    case LANE_SLT: return a < b ? 1 : 0;
+    case LANE_SLL: return b << shamt;
+    case LANE_SRL: return b >> shamt;
+    }
+    return 0;
+}
+
+static void scalarKernel(int op, ll* d, const ll* a, const ll* b, int shamt, size_t n) {
+    for(size_t i = 0; i < n; i++)
+        d[i] = laneOp(op, a[i], b[i], shamt);
+}
+
+#if defined(__x86_64__)
+// loads a and b four lanes at a time as x and y and stores expr to d
+#define AVX2_LANES(expr) \
+    for(; i + 4 <= n; i += 4) { \
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i)); \
+        __m256i y = _mm256_loadu_si256((const __m256i*) (b + i)); \
+        (void) x, (void) y; \
+        _mm256_storeu_si256((__m256i*) (d + i), expr); \
+    }
+
+__attribute__((target("avx2")))
+static void avx2Kernel(int op, ll* d, const ll* a, const ll* b, int shamt, size_t n) {
+    size_t i = 0;
+    const __m256i zero = _mm256_setzero_si256(), one = _mm256_set1_epi64x(1);
+    const __m128i count = _mm_cvtsi32_si128(shamt), fill = _mm_cvtsi32_si128(64 - shamt);
+    switch(op) {
+    case LANE_ADD: AVX2_LANES(_mm256_add_epi64(x, y)); break;
+    case LANE_SUB: AVX2_LANES(_mm256_sub_epi64(x, y)); break;
+    case LANE_AND: AVX2_LANES(_mm256_and_si256(x, y)); break;
+    case LANE_OR:  AVX2_LANES(_mm256_or_si256(x, y)); break;
+    case LANE_SLT: AVX2_LANES(_mm256_and_si256(_mm256_cmpgt_epi64(y, x), one)); break;
+    case LANE_SLL: AVX2_LANES(_mm256_sll_epi64(y, count)); break;
+    // >> is arithmetic on ll; AVX2 only shifts logically, so the sign is
+    // shifted in from a mask of the negative lanes
+    case LANE_SRL: AVX2_LANES(_mm256_or_si256(_mm256_srl_epi64(y, count),
+                                              _mm256_sll_epi64(_mm256_cmpgt_epi64(zero, y), fill))); break;
+    default:       AVX2_LANES(zero); break;
+    }
+    scalarKernel(op, d + i, a + i, b + i, shamt, n - i);
+}
+
+#define SSE_LANES(expr) \
+    for(; i + 2 <= n; i += 2) { \
+        __m128i x = _mm_loadu_si128((const __m128i*) (a + i)); \
+        __m128i y = _mm_loadu_si128((const __m128i*) (b + i)); \
+        (void) x, (void) y; \
+        _mm_storeu_si128((__m128i*) (d + i), expr); \
+    }
+
+__attribute__((target("sse4.2")))
+static void sseKernel(int op, ll* d, const ll* a, const ll* b, int shamt, size_t n) {
+    size_t i = 0;
+    const __m128i zero = _mm_setzero_si128(), one = _mm_set1_epi64x(1);
+    const __m128i count = _mm_cvtsi32_si128(shamt), fill = _mm_cvtsi32_si128(64 - shamt);
+    switch(op) {
+    case LANE_ADD: SSE_LANES(_mm_add_epi64(x, y)); break;
+    case LANE_SUB: SSE_LANES(_mm_sub_epi64(x, y)); break;
+    case LANE_AND: SSE_LANES(_mm_and_si128(x, y)); break;
+    case LANE_OR:  SSE_LANES(_mm_or_si128(x, y)); break;
+    case LANE_SLT: SSE_LANES(_mm_and_si128(_mm_cmpgt_epi64(y, x), one)); break;
+    case LANE_SLL: SSE_LANES(_mm_sll_epi64(y, count)); break;
+    case LANE_SRL: SSE_LANES(_mm_or_si128(_mm_srl_epi64(y, count),
+                                          _mm_sll_epi64(_mm_cmpgt_epi64(zero, y), fill))); break;
+    default:       SSE_LANES(zero); break;
+    }
+    scalarKernel(op, d + i, a + i, b + i, shamt, n - i);
+}
+#endif
+
+// the widest kernel the host runs, and its name
+static LaneKernel selectKernel(string& name) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        name = "avx2";
+        return avx2Kernel;
+    }
+    if(__builtin_cpu_supports("sse4.2")) {
+        name = "sse4.2";
+        return sseKernel;
+    }
+#endif
+    name = "scalar";
+    return scalarKernel;
+}
+
+// an instruction of IMEM decoded once for the whole batch
+enum LaneKind {K_NOOP, K_OTHER, K_RTYPE, K_LOAD, K_STORE, K_LUI, K_BRANCH, K_JUMP, K_JAL, K_JR};
+
+struct LaneInstruction {
+    unsigned char kind = K_NOOP, op = LANE_ZERO;
+    unsigned char rs = 0, rt = 0, rd = 0, shamt = 0;
+    bool beq = false;
+    ll offset = 0;      // of loads, stores and branches, the immediate of lui, the target of jumps
+};
+
+static LaneInstruction laneDecode(ll instruction) {
+    LaneInstruction l;
+    if(isNoop(instruction))
+        return l;
+    l.rs = getRS(instruction);
+    l.rt = getRT(instruction);
+    if(isRType(instruction)) {
+        l.kind = K_RTYPE;
+        l.rd = getRD(instruction);
+        l.shamt = (instruction >> 6) & 31;
+        static const unsigned char ops[] = {LANE_ADD, LANE_SUB, LANE_AND, LANE_OR, LANE_SLT, LANE_SLL, LANE_SRL, LANE_ZERO};
+        l.op = ops[getOperation(instruction)];
+    }
+    else if(isLoad(instruction) || isStore(instruction) || isLUI(instruction)) {
+        l.kind = isLoad(instruction) ? K_LOAD : isStore(instruction) ? K_STORE : K_LUI;
+        l.offset = getWriteOffset(instruction);
+    }
+    else if(isBranch(instruction)) {
+        l.kind = K_BRANCH;
+        l.beq = isBEQ(instruction);
+        l.offset = getBranchOffset(instruction);
+    }
+    else if(isJump(instruction) || isJAL(instruction)) {
+        l.kind = isJump(instruction) ? K_JUMP : K_JAL;
+        l.offset = 4 * getJumpOffset(instruction);
+    }
+    else if(isJR(instruction))
+        l.kind = K_JR;
+    else
+        l.kind = K_OTHER;   // executed as nothing, as by executeInstruction
+    return l;
+}
+
+template<TimingModel model>
+class Batch {
+public:
+    Batch(const InstructionMemory& IMEM, const vector<Memory*>& MEM, unsigned seed, BatchStats& stats)
+            : MEM(MEM), n(MEM.size()), rf(32 * MEM.size(), 0), offsets(MEM.size(), Counters{0, 0, 0, 0, 0, 0}),
+              decoded(decodeProgram(IMEM)), stats(stats) {
+        kernel = selectKernel(stats.kernel);
+        for(ll instruction : IMEM.imem)
+            program.push_back(laneDecode(instruction));
+        program.push_back(LaneInstruction());
+        Group all = {0, {}, Timing<model>(decoded, seed)};
+        for(size_t i = 0; i < n; i++)
+            all.lanes.push_back(i);
+        groups.push_back(all);
+        results.resize(n);
+        gatheredS.resize(n);
+        gatheredT.resize(n);
+        gatheredD.resize(n);
+    }
+
+    void run() {
+        while(!groups.empty()) {
+            stats.maxGroups = max(stats.maxGroups, groups.size());
+            size_t g = 0;
+            for(size_t i = 1; i < groups.size(); i++)
+                if(groups[i].PC < groups[g].PC)
+                    g = i;
+            if(!step(g)) {
+                retire(groups[g]);
+                groups[g] = move(groups.back());
+                groups.pop_back();
+            }
+            else if(groups.size() > 1)
+                merge(g);
+        }
+    }
+
+    vector<SimResult> results;
+
+private:
+    struct Group {
+        ll PC;
+        vector<unsigned> lanes;     // ascending
+        Timing<model> timing;
+    };
+
+    inline ll* row(int reg) {
+        return rf.data() + reg * n;
+    }
+
+    // one fetch of groups[g] and the execution of what it fetched; false
+    // once the group has stopped
+    bool step(size_t g) {
+        Group& group = groups[g];
+        if(!group.timing.untilFetch())
+            return false;
+        ll PC = group.PC;
+        bool inside = PC >= 0 && (size_t) (PC / 4) < program.size() - 1;
+        unsigned index = inside ? PC / 4 : program.size() - 1;
+        group.timing.fetch(index);
+        stats.fetches++;
+        const LaneInstruction& l = program[index];
+        if(l.kind == K_NOOP) {
+            // the pipeline fetches on past a noop until it drains
+            group.PC += 4;
+            return true;
+        }
+        const vector<unsigned>& lanes = group.lanes;
+        bool all = lanes.size() == n;
+        stats.lockstepFetches += all;
+        stats.instructions += lanes.size();
+        ll* s = row(l.rs);
+        ll* t = row(l.rt);
+        group.PC += 4;
+        switch(l.kind) {
+        case K_OTHER:
+            break;
+        case K_RTYPE: {
+            size_t first = lanes[0], count = lanes.size();
+            if(lanes.back() - first + 1 == count) {
+                // the lanes are one run of a row, as every lane is for all
+                kernel(l.op, row(l.rd) + first, s + first, t + first, l.shamt, count);
+                break;
+            }
+            for(size_t k = 0; k < count; k++) {
+                gatheredS[k] = s[lanes[k]];
+                gatheredT[k] = t[lanes[k]];
+            }
+            kernel(l.op, gatheredD.data(), gatheredS.data(), gatheredT.data(), l.shamt, count);
+            ll* d = row(l.rd);
+            for(size_t k = 0; k < count; k++)
+                d[lanes[k]] = gatheredD[k];
+            break;
+        }
+        case K_LOAD:
+            for(unsigned i : lanes)
+                t[i] = MEM[i]->memory[(s[i] + l.offset) / 4];
+            break;
+        case K_STORE:
+            for(unsigned i : lanes)
+                MEM[i]->store((s[i] + l.offset) / 4, t[i]);
+            break;
+        case K_LUI:
+            for(unsigned i : lanes)
+                t[i] = l.offset << 16;
+            break;
+        case K_JUMP:
+            group.PC = l.offset;
+            break;
+        case K_JAL:
+            for(unsigned i : lanes)
+                row(31)[i] = PC + 4;
+            group.PC = l.offset;
+            break;
+        case K_BRANCH: {
+            ll taken = PC + 4 + l.offset * 4;
+            next.clear();
+            for(unsigned i : lanes)
+                next.push_back((l.beq ? s[i] == t[i] : s[i] != t[i]) ? taken : PC + 4);
+            split(g);
+            break;
+        }
+        case K_JR:
+            next.clear();
+            for(unsigned i : lanes)
+                next.push_back(s[i]);
+            split(g);
+            break;
+        }
+        return true;
+    }
+
+    // moves the lanes of groups[g] to next, in new groups where they differ
+    void split(size_t g) {
+        ll first = next[0];
+        if(all_of(next.begin(), next.end(), [&](ll PC) { return PC == first; })) {
+            groups[g].PC = first;
+            return;
+        }
+        vector<Group> parts;
+        vector<unsigned> stay;
+        for(size_t k = 0; k < next.size(); k++) {
+            unsigned lane = groups[g].lanes[k];
+            if(next[k] == first) {
+                stay.push_back(lane);
+                continue;
+            }
+            auto part = find_if(parts.begin(), parts.end(), [&](const Group& p) { return p.PC == next[k]; });
+            if(part == parts.end()) {
+                parts.push_back({next[k], {}, groups[g].timing});
+                part = parts.end() - 1;
+            }
+            part->lanes.push_back(lane);
+        }
+        groups[g].PC = first;
+        groups[g].lanes = move(stay);
+        stats.splits += parts.size();
+        for(Group& part : parts)
+            groups.push_back(move(part));
+    }
+
+    // merges every group that will be timed as groups[g] into it
+    void merge(size_t g) {
+        for(size_t h = 0; h < groups.size(); h++) {
+            if(h == g || groups[h].PC != groups[g].PC || !groups[h].timing.sameState(groups[g].timing))
+                continue;
+            const Counters& from = groups[h].timing.c;
+            const Counters& to = groups[g].timing.c;
+            for(unsigned lane : groups[h].lanes) {
+                Counters& o = offsets[lane];
+                o.cycles += from.cycles - to.cycles;
+                o.instructions += from.instructions - to.instructions;
+                o.hazardStalls += from.hazardStalls - to.hazardStalls;
+                o.branchStalls += from.branchStalls - to.branchStalls;
+                o.jumpStalls += from.jumpStalls - to.jumpStalls;
+                o.loadStalls += from.loadStalls - to.loadStalls;
+            }
+            vector<unsigned> lanes;
+            mergeLanes(groups[g].lanes, groups[h].lanes, lanes);
+            groups[g].lanes = move(lanes);
+            stats.merges++;
+            if(g == groups.size() - 1)
+                g = h;
+            groups[h] = move(groups.back());
+            groups.pop_back();
+            h--;
+        }
+    }
+
+    static void mergeLanes(const vector<unsigned>& a, const vector<unsigned>& b, vector<unsigned>& out) {
+        out.resize(a.size() + b.size());
+        std::merge(a.begin(), a.end(), b.begin(), b.end(), out.begin());
+    }
+
+    void retire(const Group& group) {
+        for(unsigned lane : group.lanes) {
+            SimResult& r = results[lane];
+            r.cycles = group.timing.c.cycles + offsets[lane].cycles;
+            r.instructions = group.timing.c.instructions + offsets[lane].instructions;
+            r.rf.resize(32);
+            for(int reg = 0; reg < 32; reg++)
+                r.rf[reg] = row(reg)[lane];
+        }
+    }
+
+    const vector<Memory*>& MEM;
+    size_t n;
+    vector<ll> rf;
+    vector<Counters> offsets;   // per instance, its cycles before its last merge minus those of its group
+    vector<Decoded> decoded;
+    vector<LaneInstruction> program;
+    vector<Group> groups;
+    vector<ll> next;            // per lane of a branching group
+    // the operands and results of a group whose lanes are not one run
+    vector<ll> gatheredS, gatheredT, gatheredD;
+    LaneKernel kernel;
+    BatchStats& stats;
+};
+
+string batchBlocker(const Options& options, const InstructionMemory& IMEM) {
+    if(options.interval > 0)
+        return "batch runs do not split into intervals";
+    return decoupleBlocker(options, IMEM);
+}
+
+vector<SimResult> runBatch(TimingModel model, CoreFactory fallback, const Options& options,
+        InstructionMemory& IMEM, const vector<Memory*>& MEM, HostPerf& perf, BatchStats* stats) {
+    BatchStats local;
+    if(stats == nullptr)
+        stats = &local;
+    vector<SimResult> results;
+    if(MEM.empty())
+        return results;
+    if(batchBlocker(options, IMEM) != "") {
+        for(Memory* m : MEM)
+            results.push_back(runCore(fallback, options, IMEM, *m, perf));
+        return results;
+    }
+
+    perf.begin(PHASE_SIMULATE);
+    unsigned seed = options.seed >= 0 ? options.seed : time(NULL);
+    if(model == TIMING_STALL) {
+        Batch<TIMING_STALL> batch(IMEM, MEM, seed, *stats);
+        batch.run();
+        results = move(batch.results);
+    }
+    else if(model == TIMING_FORWARD) {
+        Batch<TIMING_FORWARD> batch(IMEM, MEM, seed, *stats);
+        batch.run();
+        results = move(batch.results);
+    }
+    else {
+        Batch<TIMING_FORWARD_MISS> batch(IMEM, MEM, seed, *stats);
+        batch.run();
+        results = move(batch.results);
+    }
+    perf.end(PHASE_SIMULATE);
+    return results;
+}
+
+vector<SimResult> runBatchProcSim1(const Options& options, InstructionMemory& IMEM, const vector<Memory*>& MEM,
+        HostPerf& perf, BatchStats* stats) {
+    return runBatch(TIMING_STALL, newProcSim1, options, IMEM, MEM, perf, stats);
+}
+
+vector<SimResult> runBatchProcSim2(const Options& options, InstructionMemory& IMEM, const vector<Memory*>& MEM,
+        HostPerf& perf, BatchStats* stats) {
+    return runBatch(TIMING_FORWARD, newProcSim2, options, IMEM, MEM, perf, stats);
+}
+
+vector<SimResult> runBatchProcSim3(const Options& options, InstructionMemory& IMEM, const vector<Memory*>& MEM,
+        HostPerf& perf, BatchStats* stats) {
+    return runBatch(TIMING_FORWARD_MISS, newProcSim3, options, IMEM, MEM, perf, stats);
+}
+
+void reportBatch(ostream& out, const BatchStats& stats, size_t instances) {
+    char line[256];
+    snprintf(line, sizeof(line),
+             "batch of %zu: %lld fetches, %.1f%% in lockstep, %.1f instances per fetch, %lld splits, %lld merges, at most %zu groups, %s kernels\n",
+             instances, stats.fetches, 100.0 * stats.lockstepFetches / max(1LL, stats.fetches),
+             (double) stats.instructions / max(1LL, stats.fetches), stats.splits, stats.merges,
+             stats.maxGroups, stats.kernel.c_str());
+    out << line;
+}
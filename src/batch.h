@@ -0,0 +1,64 @@
+#ifndef BATCH_HEADER
+#define BATCH_HEADER
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "simulator.h"
+#include "timing.h"
+#define ll long long
+using namespace std;
+
+/*
+    Batch runs simulate one program on many memories, as sweeps over inputs
+    do, on one thread. The registers of all instances are kept as structure
+    of arrays, register r of instance i at rf[r * instances + i], and
+    instances at the same PC form a group that fetches once, is timed by
+    one Timing (timing.h) and executes each instruction for all of its
+    members together: register-register instructions run as AVX2 or SSE4.2
+    kernels where the host has them, with a scalar fallback, over the run
+    of a row a group's instances form or, where they are scattered, over
+    their operands gathered into a buffer, while loads and stores go to the
+    memory of each instance in turn. A branch or jr on which the instances
+    disagree splits the group; the parts copy its timing state. The group
+    with the lowest PC runs first, so parts of a split catch up with each
+    other, and two groups at the same PC whose Timing has the same state
+    merge again: from there on they are timed alike, and the cycles they
+    took until then are kept per instance.
+
+    Each instance ends with the registers, memory, cycles and instructions
+    of a run of the full pipeline on its memory. As the execution is
+    functional, a batch run is refused under the conditions of
+    decoupleBlocker and then runs the instances one after the other.
+*/
+
+struct BatchStats {
+    ll fetches = 0;             // by all groups
+    ll lockstepFetches = 0;     // by a group holding every instance
+    ll instructions = 0;        // executed, over all instances
+    ll splits = 0, merges = 0;
+    size_t maxGroups = 0;
+    string kernel;              // avx2, sse4.2 or scalar
+};
+
+// why a batch run would not match the pipeline, empty if it would
+string batchBlocker(const Options& options, const InstructionMemory& IMEM);
+
+/*
+    A batch run of model over MEM, or runs of fallback one at a time if
+    batchBlocker objects. The i-th result is that of MEM[i].
+*/
+vector<SimResult> runBatch(TimingModel model, CoreFactory fallback, const Options& options,
+        InstructionMemory& IMEM, const vector<Memory*>& MEM, HostPerf& perf, BatchStats* stats = nullptr);
+
+vector<SimResult> runBatchProcSim1(const Options& options, InstructionMemory& IMEM, const vector<Memory*>& MEM,
+        HostPerf& perf, BatchStats* stats = nullptr);
+vector<SimResult> runBatchProcSim2(const Options& options, InstructionMemory& IMEM, const vector<Memory*>& MEM,
+        HostPerf& perf, BatchStats* stats = nullptr);
+vector<SimResult> runBatchProcSim3(const Options& options, InstructionMemory& IMEM, const vector<Memory*>& MEM,
+        HostPerf& perf, BatchStats* stats = nullptr);
+
+// one line for stderr
+void reportBatch(ostream& out, const BatchStats& stats, size_t instances);
+
+#endif
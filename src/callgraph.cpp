@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include "callgraph.h"
+#define ll long long
+
+using namespace std;
+
+CallGraph::CallGraph(string file) : file(file) {
+    enabled = file != "";
+    nodes.push_back(Node(-1, -1));
+}
+
+void CallGraph::call(ll entry) {
+    for(pair<ll, int>& child : nodes[current].children) {
+        if(child.first == entry) {
+            current = child.second;
+            return;
+        }
+    }
+    nodes.push_back(Node(entry, current));
+    nodes[current].children.push_back({entry, (int) nodes.size() - 1});
+    current = nodes.size() - 1;
+}
+
+void CallGraph::ret() {
+    // a return with nothing on the stack leaves the program's top level
+    if(nodes[current].parent >= 0)
+        current = nodes[current].parent;
+}
+
+ll CallGraph::inclusive(int node) {
+    ll total = nodes[node].cycles;
+    for(pair<ll, int>& child : nodes[node].children)
+        total += inclusive(child.second);
+    return total;
+}
+
+static string frame(ll entry) {
+    return entry < 0 ? "main" : "fn@" + to_string(entry);
+}
+
+void CallGraph::finish() {
+    if(!enabled)
+        return;
+    FILE* out = fopen(file.c_str(), "w");
+    FILE* summary = fopen((file + ".summary").c_str(), "w");
+    if(out == nullptr || summary == nullptr) {
+        cerr << "cannot write call graph to " << file << endl;
+        if(out != nullptr)
+            fclose(out);
+        if(summary != nullptr)
+            fclose(summary);
+        return;
+    }
+
+    // entry -> {inclusive, exclusive}; recursion is counted once inclusively
+    map<ll, pair<ll, ll>> functions;
+    vector<string> stacks(nodes.size());
+    for(size_t i = 0; i < nodes.size(); i++) {
+        Node& n = nodes[i];
+        stacks[i] = n.parent < 0 ? frame(n.entry) : stacks[n.parent] + ";" + frame(n.entry);
+        if(n.cycles > 0)
+            fprintf(out, "%s %lld\n", stacks[i].c_str(), n.cycles);
+
+        functions[n.entry].second += n.cycles;
+        bool outermost = true;
+        for(int p = n.parent; p >= 0 && outermost; p = nodes[p].parent)
+            outermost = nodes[p].entry != n.entry;
+        if(outermost)
+            functions[n.entry].first += inclusive(i);
+    }
+
+    vector<pair<ll, ll>> order;     // {inclusive, entry}
+    for(auto& f : functions)
+        order.push_back({f.second.first, f.first});
+    sort(order.rbegin(), order.rend());
+    fprintf(summary, "%-12s %12s %12s\n", "function", "inclusive", "exclusive");
+    for(pair<ll, ll>& o : order)
+        fprintf(summary, "%-12s %12lld %12lld\n", frame(o.second).c_str(),
+                functions[o.second].first, functions[o.second].second);
+    fclose(out);
+    fclose(summary);
+}
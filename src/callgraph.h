@@ -0,0 +1,60 @@
+#ifndef CALLGRAPH_HEADER
+#define CALLGRAPH_HEADER
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "instruction.h"
+#define ll long long
+using namespace std;
+
+/*
+    Guest call-graph profiler. A shadow call stack follows the simulated
+    program: a jal pushes its target and a jr $ra pops, both when they
+    reach write back. Every cycle is charged to the stack current at that
+    point, so the counts are exact rather than sampled.
+
+    finish() writes folded stacks ("main;fn@20;fn@64 1234"), which
+    flamegraph.pl and speedscope read, and next to them a ".summary" file
+    with inclusive and exclusive cycles per function entry PC.
+*/
+
+class CallGraph {
+public:
+    // no file disables the profiler; cycle() must then not be called
+    CallGraph(string file = "");
+
+    // call once per cycle; instruction is the one in MEMWB
+    inline void cycle(ll instruction, bool retired) {
+        if(retired) {
+            if(isJAL(instruction))
+                call(4 * getJumpOffset(instruction));
+            else if(isJR(instruction) && getRS(instruction) == 31)
+                ret();
+        }
+        nodes[current].cycles++;
+    }
+
+    void finish();
+
+    bool enabled = false;
+
+    struct Node {
+        ll entry;       // entry PC, -1 for the root
+        int parent;
+        ll cycles = 0;  // exclusive
+        vector<pair<ll, int>> children;
+        Node(ll entry, int parent) : entry(entry), parent(parent) {}
+    };
+    vector<Node> nodes;
+
+private:
+    void call(ll entry);
+    void ret();
+    ll inclusive(int node);
+
+    string file;
+    int current = 0;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include "component.h"
+
+void EventQueue::schedule(ll at, coroutine_handle<> handle) {
+    // a slot behind the current one would only come round WHEEL cycles later
+    if(at < cycle)
+        at = cycle;
+    if(at - cycle >= WHEEL)
+        later.emplace(at, handle);
+    else
+        wheel[at & (WHEEL - 1)].push_back(handle);
+}
+
+void EventQueue::step() {
+    vector<coroutine_handle<>>& slot = wheel[cycle & (WHEEL - 1)];
+    // those from further out began to wait before any in the slot
+    for(size_t i = 0; !later.empty() && later.begin()->first == cycle; i++) {
+        slot.insert(slot.begin() + i, later.begin()->second);
+        later.erase(later.begin());
+    }
+    // resuming may schedule into this slot, so it is indexed afresh each time
+    for(size_t i = 0; i < slot.size(); i++)
+        slot[i].resume();
+    slot.clear();
+    cycle++;
+}
@@ -0,0 +1,177 @@
+#ifndef COMPONENT_HEADER
+#define COMPONENT_HEADER
+
+#include <coroutine>
+#include <map>
+#include <utility>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Components of a simulated machine as C++20 coroutines. A pipeline
+    stage, a memory or any other unit is a function that loops over its
+    work and co_awaits whatever it depends on in between: a cycle of the
+    EventQueue, a Signal another component raises within a cycle, or the
+    reply of a unit behind a Port. A suspended component is its coroutine
+    frame and nothing else, so a unit that waits N cycles costs no more
+    than one that waits one, and nothing has to poll a flag to find out
+    that it is still waiting. Needs -std=c++20.
+*/
+
+// a running component; destroying it destroys its frame wherever it waits
+class Component {
+public:
+    struct promise_type {
+        Component get_return_object() {
+            return Component(coroutine_handle<promise_type>::from_promise(*this));
+        }
+        // a component first runs when start() is called
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        // to whoever resumed it, as a plain call would
+        void unhandled_exception() { throw; }
+    };
+
+    Component() = default;
+    Component(Component&& other) : handle(exchange(other.handle, nullptr)) {}
+    Component& operator=(Component&& other) {
+        if(handle)
+            handle.destroy();
+        handle = exchange(other.handle, nullptr);
+        return *this;
+    }
+    ~Component() {
+        if(handle)
+            handle.destroy();
+    }
+
+    // runs the component up to its first co_await
+    void start() {
+        handle.resume();
+    }
+
+private:
+    explicit Component(coroutine_handle<promise_type> handle) : handle(handle) {}
+    coroutine_handle<promise_type> handle = nullptr;
+};
+
+/*
+    Cycle-driven scheduling: step() resumes the components that wait for
+    the current cycle in the order they began to wait, including those
+    that wait for it while it runs. Only what is due is visited.
+*/
+class EventQueue {
+public:
+    struct Wait {
+        EventQueue& queue;
+        ll cycle;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(coroutine_handle<> handle) { queue.schedule(cycle, handle); }
+        void await_resume() const noexcept {}
+    };
+
+    // suspends the caller until cycle, or the current one if cycle has passed
+    Wait at(ll cycle) {
+        return Wait{*this, cycle};
+    }
+
+    // runs everything due in the current cycle, then moves to the next
+    void step();
+
+    ll cycle = 0;       // the cycle that runs or runs next
+
+private:
+    void schedule(ll at, coroutine_handle<> handle);
+
+    // the next WHEEL cycles, a power of two, at wheel[cycle % WHEEL], and
+    // what is further out
+    static const int WHEEL = 64;
+    vector<coroutine_handle<>> wheel[WHEEL];
+    multimap<ll, coroutine_handle<>> later;
+};
+
+/*
+    An edge one component raises for another within a cycle, like a valid
+    wire between two stages. A raise nobody waits for is lost, so a stage
+    that is busy with something else simply does not see it.
+*/
+class Signal {
+public:
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(coroutine_handle<> handle) { waiter = handle; }
+    void await_resume() const noexcept {}
+
+    // runs the waiting component until it suspends again
+    void raise() {
+        if(waiter)
+            exchange(waiter, nullptr).resume();
+    }
+
+private:
+    coroutine_handle<> waiter = nullptr;
+};
+
+/*
+    A request from a client component to a server component, e.g. a load
+    from a memory stage to a memory. The client co_awaits request(), the
+    server co_awaits serve() for the next one, finds it in pending and
+    answers it by setting response before it co_awaits serve() again. A
+    server that answers without waiting hands control straight back to
+    the client, so a request that takes no cycles costs two switches. A
+    request made before the server waits in serve() is kept until it does.
+*/
+template<class Request, class Response>
+class Port {
+public:
+    struct Call {
+        Port& port;
+        Request request;
+        bool await_ready() const noexcept { return false; }
+        coroutine_handle<> await_suspend(coroutine_handle<> handle) {
+            port.client = handle;
+            port.pending = request;
+            if(!port.server) {
+                port.queued = true;
+                return noop_coroutine();
+            }
+            return exchange(port.server, nullptr);
+        }
+        Response await_resume() const { return port.response; }
+    };
+
+    struct Serve {
+        Port& port;
+        bool await_ready() const noexcept { return false; }
+        coroutine_handle<> await_suspend(coroutine_handle<> handle) {
+            // a request that came first is served at once
+            if(exchange(port.queued, false))
+                return handle;
+            port.server = handle;
+            if(port.client)
+                return exchange(port.client, nullptr);
+            return noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    // for the client
+    Call request(const Request& r) {
+        return Call{*this, r};
+    }
+    // for the server
+    Serve serve() {
+        return Serve{*this};
+    }
+
+    Request pending = Request();
+    Response response = Response();
+
+private:
+    // server is only set while it waits in serve(); queued if a request waits for it
+    coroutine_handle<> client = nullptr, server = nullptr;
+    bool queued = false;
+};
+
+#endif
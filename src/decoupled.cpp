@@ -0,0 +1,123 @@
+#include <atomic>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include "decoupled.h"
+#include "instruction.h"
+#include "reference.h"
+#include "ring.h"
+#define ll long long
+
+using namespace std;
+
+// how the back end answers a front end waiting at a noop
+enum Verdict {WAIT, CONTINUE, STOP};
+
+string decoupleBlocker(const Options& options, const InstructionMemory& IMEM) {
+    if(options.hooksEnabled())
+        return "memory hooks need every access in its cycle";
+    if(options.statsFile != "" || options.traceFile != "" || options.profileFile != ""
+            || options.callGraphFile != "")
+        return "stats, traces, profiles and call graphs need the latches of every cycle";
+    if(options.maxCycles != 0)
+        return "--max-cycles would stop the pipeline behind the functional state";
+    if(options.mshrs > 0)
+        return "the timing back end only replays blocking loads";
+    if(IMEM.entry != 0 || IMEM.stackPointer != 0 || IMEM.globalPointer != 0)
+        return "the functional front end starts at address 0 with zero registers";
+    bool links = false, writesRA = false;
+    for(ll instruction : IMEM.imem) {
+        links = links || isJAL(instruction);
+        writesRA = writesRA || (!isNoop(instruction) && !isJAL(instruction) && getWriteReg(instruction) == 31);
+    }
+    if(links && writesRA)
+        return "the program writes $ra other than by jal";
+    return "";
+}
+
+/*
+    Executes the program and pushes the index of every fetched instruction,
+    IMEM.imem.size() for a fetch outside of instruction memory.
+*/
+static void frontEnd(const InstructionMemory& IMEM, Memory& MEM, vector<ll>& rf,
+        RingBuffer<unsigned>& ring, atomic<int>& verdict) {
+    const vector<ll>& imem = IMEM.imem;
+    ll PC = 0;
+    while(true) {
+        bool inside = PC >= 0 && (size_t) (PC / 4) < imem.size();
+        unsigned index = inside ? PC / 4 : imem.size();
+        ring.push(index);
+        ll instruction = inside ? imem[index] : 0;
+        if(!isNoop(instruction)) {
+            PC = executeInstruction(instruction, PC, rf, MEM);
+            continue;
+        }
+        int v;
+        while((v = verdict.load(memory_order_acquire)) == WAIT)
+            this_thread::yield();
+        if(v == STOP)
+            return;
+        verdict.store(WAIT, memory_order_relaxed);
+        PC += 4;
+    }
+}
+
+// feeds a Timing from the ring and answers the front end at noops
+template<TimingModel model>
+static Counters backEnd(const vector<Decoded>& decoded, RingBuffer<unsigned>& ring,
+        atomic<int>& verdict, unsigned seed) {
+    Timing<model> timing(decoded, seed);
+    bool afterNoop = false;     // the front end waits for a verdict
+    while(timing.untilFetch()) {
+        if(afterNoop)
+            verdict.store(CONTINUE, memory_order_release);
+        unsigned index;
+        while(!ring.tryPop(index))
+            this_thread::yield();
+        afterNoop = decoded[index].flags & F_NOOP;
+        timing.fetch(index);
+    }
+    verdict.store(STOP, memory_order_release);
+    return timing.c;
+}
+
+SimResult runDecoupled(TimingModel model, CoreFactory fallback, const Options& options,
+        InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    if(decoupleBlocker(options, IMEM) != "")
+        return runCore(fallback, options, IMEM, MEM, perf);
+
+    perf.begin(PHASE_SIMULATE);
+    vector<Decoded> decoded = decodeProgram(IMEM);
+
+    SimResult result;
+    result.rf = vector<ll>(32, 0);
+    RingBuffer<unsigned> ring(RING_CAPACITY);
+    atomic<int> verdict(WAIT);
+    thread producer(frontEnd, cref(IMEM), ref(MEM), ref(result.rf), ref(ring), ref(verdict));
+    unsigned seed = options.seed >= 0 ? options.seed : time(NULL);
+    Counters c;
+    if(model == TIMING_STALL)
+        c = backEnd<TIMING_STALL>(decoded, ring, verdict, seed);
+    else if(model == TIMING_FORWARD)
+        c = backEnd<TIMING_FORWARD>(decoded, ring, verdict, seed);
+    else
+        c = backEnd<TIMING_FORWARD_MISS>(decoded, ring, verdict, seed);
+    producer.join();
+    perf.end(PHASE_SIMULATE);
+
+    result.cycles = c.cycles;
+    result.instructions = c.instructions;
+    return result;
+}
+
+SimResult runDecoupledProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runDecoupled(TIMING_STALL, newProcSim1, options, IMEM, MEM, perf);
+}
+
+SimResult runDecoupledProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runDecoupled(TIMING_FORWARD, newProcSim2, options, IMEM, MEM, perf);
+}
+
+SimResult runDecoupledProcSim3(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runDecoupled(TIMING_FORWARD_MISS, newProcSim3, options, IMEM, MEM, perf);
+}
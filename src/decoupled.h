@@ -0,0 +1,49 @@
+#ifndef DECOUPLED_HEADER
+#define DECOUPLED_HEADER
+
+#include <string>
+#include "simulator.h"
+#include "timing.h"
+#define ll long long
+using namespace std;
+
+/*
+    Decoupled runs split a simulation over two threads. A functional front
+    end executes the program ahead of the pipeline, as the model in
+    reference.h does, and passes the address of every instruction it fetches
+    through a RingBuffer to a timing back end. The back end replays only the
+    control of proc_simN on pre-decoded instructions: load-use and data
+    hazards, branch and jump bubbles and, for proc_sim3, the random load
+    misses. The front end produces the final registers and memory, the back
+    end the cycle, instruction and stall counts, and both are exactly those
+    of the full pipeline. A full ring blocks the front end, so a slow back
+    end holds it at most RING_CAPACITY instructions ahead. The back end is
+    a Timing (timing.h).
+
+    The pipeline fetches past a noop if older instructions are still in
+    flight and stops once all latches hold noops, which depends on timing.
+    The front end therefore waits at every noop until the back end either
+    fetches the next instruction or stops.
+
+    A decoupled run would differ from the pipeline, and the full pipeline
+    runs instead, when the options need the latches of every cycle (hooks,
+    stats, traces, profiles, call graphs, --max-cycles) or when a program
+    with jal also writes $ra otherwise: jal links in the fetch stage, so an
+    older write to $ra still in flight lands after the link in the pipeline
+    but before it in program order.
+*/
+
+#define RING_CAPACITY 4096
+
+// why a decoupled run would not match the pipeline, empty if it would
+string decoupleBlocker(const Options& options, const InstructionMemory& IMEM);
+
+// a decoupled run of model, or of fallback if decoupleBlocker objects
+SimResult runDecoupled(TimingModel model, CoreFactory fallback, const Options& options,
+        InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+
+SimResult runDecoupledProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+SimResult runDecoupledProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+SimResult runDecoupledProcSim3(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+
+#endif
@@ -0,0 +1,218 @@
+#include <charconv>
+#include <cstdint>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "dump.h"
+#define ll long long
+
+using namespace std;
+
+#define DUMP_BUFFER_BYTES (1 << 20)
+
+class OutputBuffer {
+public:
+    OutputBuffer(int fd) : fd(fd) {
+        buffer = new char[DUMP_BUFFER_BYTES];
+    }
+
+    ~OutputBuffer() {
+        flush();
+        delete[] buffer;
+    }
+
+    void flush() {
+        writeAll(buffer, used);
+        used = 0;
+    }
+
+    void bytes(const void* data, size_t n) {
+        if(used + n > DUMP_BUFFER_BYTES)
+            flush();
+        if(n > DUMP_BUFFER_BYTES) {
+            writeAll(data, n);
+            return;
+        }
+        memcpy(buffer + used, data, n);
+        used += n;
+    }
+
+    void text(const char* s) {
+        bytes(s, strlen(s));
+    }
+
+    void number(ll value) {
+        if(used + 24 > DUMP_BUFFER_BYTES)
+            flush();
+        used = to_chars(buffer + used, buffer + DUMP_BUFFER_BYTES, value).ptr - buffer;
+    }
+
+    void character(char c) {
+        if(used == DUMP_BUFFER_BYTES)
+            flush();
+        buffer[used++] = c;
+    }
+
+    template<class T>
+    void raw(T value) {
+        bytes(&value, sizeof(value));
+    }
+
+    // the errno of the first write that failed, 0 if all went out
+    int error = 0;
+
+private:
+    // nothing more is written once a write has failed
+    void writeAll(const void* data, size_t n) {
+        size_t done = 0;
+        while(done < n && error == 0) {
+            ssize_t written = ::write(fd, (const char*) data + done, n - done);
+            if(written < 0 && errno == EINTR)
+                continue;
+            if(written <= 0)
+                error = written < 0 ? errno : EIO;
+            else
+                done += written;
+        }
+    }
+
+    int fd;
+    char* buffer;
+    size_t used = 0;
+};
+
+bool parseDumpFormat(string name, DumpFormat& format) {
+    if(name == "text")
+        format = DUMP_TEXT;
+    else if(name == "nonzero")
+        format = DUMP_NONZERO;
+    else if(name == "touched")
+        format = DUMP_TOUCHED;
+    else if(name == "binary")
+        format = DUMP_BINARY;
+    else
+        return false;
+    return true;
+}
+
+static void writeHeader(OutputBuffer& out, ll numCycles, ll numInstr, vector<ll> &rf) {
+    out.text("Cycles: ");
+    out.number(numCycles);
+    out.text("\nInstructions: ");
+    out.number(numInstr);
+    out.text("\n\nRegister file: \n");
+    for(int i = 0; i < 4; i++) {
+        for(int j = 0; j < 8; j++) {
+            out.number(rf[8 * i + j]);
+            out.character(' ');
+        }
+        out.character('\n');
+    }
+    out.text("\nMemory: \n");
+}
+
+static void writeWord(OutputBuffer& out, size_t index, ll value) {
+    out.number(index * 4);
+    out.character(':');
+    out.number(value);
+    out.character('\n');
+}
+
+static void writeText(OutputBuffer& out, ll* memory) {
+    for(int i = 0; i < 20; i++) {
+        for(int j = 0; j < 5000; j++) {
+            out.number(memory[5000 * i + j]);
+            out.character(' ');
+        }
+        out.character('\n');
+    }
+    out.character('\n');
+}
+
+static void writeNonzero(OutputBuffer& out, Memory& MEM) {
+    for(size_t i = 0; i < MEM.size; i++) {
+        if(MEM.memory[i] != 0)
+            writeWord(out, i, MEM.memory[i]);
+    }
+}
+
+static void writeTouched(OutputBuffer& out, Memory& MEM) {
+    vector<size_t> pages = MEM.dirtyPages;
+    sort(pages.begin(), pages.end());
+    size_t pageWords = (size_t) 1 << MEM.pageShift;
+    for(size_t page : pages) {
+        size_t end = min(MEM.size, (page + 1) * pageWords);
+        for(size_t i = page * pageWords; i < end; i++)
+            writeWord(out, i, MEM.memory[i]);
+    }
+}
+
+static void writeBinary(OutputBuffer& out, ll numCycles, ll numInstr, vector<ll> &rf, Memory& MEM) {
+    out.bytes(DUMP_MAGIC, 8);
+    out.raw<uint32_t>(DUMP_VERSION);
+    out.raw<uint32_t>(rf.size());
+    out.raw<uint64_t>(numCycles);
+    out.raw<uint64_t>(numInstr);
+    out.raw<uint64_t>(MEM.size);
+    for(ll r : rf)
+        out.raw<int64_t>(r);
+    size_t i = 0;
+    while(i < MEM.size) {
+        if(MEM.memory[i] == 0) {
+            i++;
+            continue;
+        }
+        size_t end = i;
+        while(end < MEM.size && MEM.memory[end] != 0)
+            end++;
+        out.raw<uint64_t>(i);
+        out.raw<uint64_t>(end - i);
+        out.bytes(MEM.memory + i, (end - i) * sizeof(ll));
+        i = end;
+    }
+    out.raw<uint64_t>(0);
+    out.raw<uint64_t>(0);
+}
+
+bool writeLogs(ll numCycles, ll numInstr, vector<ll> &rf, Memory& MEM, DumpFormat format, string file) {
+    /*  
+        In the logs, we mention number of cycles required, total instruction
+        executed, contents of the register files and the contents of the
+        memory file. 
+    */
+    bool toStdout = file == "" || file == "-";
+    string name = toStdout ? "standard output" : file;
+    int fd = toStdout ? 1 : open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        cerr << "cannot write " << name << ": " << strerror(errno) << endl;
+        return false;
+    }
+
+    int error = 0;
+    {
+        OutputBuffer out(fd);
+        if(format == DUMP_BINARY)
+            writeBinary(out, numCycles, numInstr, rf, MEM);
+        else {
+            writeHeader(out, numCycles, numInstr, rf);
+            if(format == DUMP_TEXT)
+                writeText(out, MEM.memory);
+            else if(format == DUMP_NONZERO)
+                writeNonzero(out, MEM);
+            else
+                writeTouched(out, MEM);
+        }
+        out.flush();
+        error = out.error;
+    }
+    if(!toStdout && close(fd) != 0 && error == 0)
+        error = errno;
+    if(error != 0) {
+        cerr << "cannot write " << name << ": " << strerror(error) << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef DUMP_HEADER
+#define DUMP_HEADER
+
+#include <string>
+#include <vector>
+#include "memory.h"
+#define ll long long
+using namespace std;
+
+/*
+    Final state dump. All formats are written through a large buffer with
+    no per-line flushing.
+
+    DUMP_TEXT     the original format read by tests/checker.py: the first
+                  MEMORY_SIZE words in 20 rows
+    DUMP_NONZERO  same header and register file, then one "address:value"
+                  line per non-zero word (byte addresses)
+    DUMP_TOUCHED  like DUMP_NONZERO, but every word of each page the run
+                  stored to, including zeros; no scan of the whole memory
+    DUMP_BINARY   little-endian: char magic[8] = "MIPSDMP", u32 version,
+                  u32 registerCount, u64 cycles, u64 instructions,
+                  u64 memoryWords, registerCount x i64 registers, then
+                  runs of { u64 base (word), u64 length, length x i64 }
+                  covering the non-zero words, ended by a run of length 0
+*/
+
+enum DumpFormat {DUMP_TEXT, DUMP_NONZERO, DUMP_TOUCHED, DUMP_BINARY};
+
+#define DUMP_MAGIC "MIPSDMP"
+#define DUMP_VERSION 1
+
+bool parseDumpFormat(string name, DumpFormat& format);
+// file "" or "-" is stdout; false, with the reason on stderr, if it could not be written
+bool writeLogs(ll numCycles, ll numInstr, vector<ll> &rf, Memory& MEM,
+        DumpFormat format = DUMP_TEXT, string file = "");
+
+#endif
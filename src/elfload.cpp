@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <elf.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "elfload.h"
+#define ll long long
+
+using namespace std;
+
+#define ELF_PAGE_BYTES 4096
+
+// fields are big-endian whatever the host is
+static inline uint32_t be32(const unsigned char* p) {
+    return (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 | (uint32_t) p[2] << 8 | p[3];
+}
+
+static inline uint16_t be16(const unsigned char* p) {
+    return p[0] << 8 | p[1];
+}
+
+bool isElfFile(string file) {
+    char magic[SELFMAG] = {0};
+    ifstream myfile (file, ios::binary);
+    if(!myfile.read(magic, SELFMAG))
+        return false;
+    return memcmp(magic, ELFMAG, SELFMAG) == 0;
+}
+
+ElfFile::ElfFile(string file) {
+    fd = open(file.c_str(), O_RDONLY);
+    if(fd < 0)
+        return;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Elf32_Ehdr))
+        return;
+    length = st.st_size;
+    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED) {
+        length = 0;
+        return;
+    }
+    data = (const unsigned char*) p;
+    valid = parse(file);
+    if(valid)
+        findGlobalPointer();
+    else
+        segments.clear();
+}
+
+bool ElfFile::parse(const string& file) {
+    const unsigned char* ident = data;
+    if(memcmp(ident, ELFMAG, SELFMAG) != 0 || ident[EI_CLASS] != ELFCLASS32 || ident[EI_DATA] != ELFDATA2MSB) {
+        cerr << file << ": not a 32-bit big-endian ELF file" << endl;
+        return false;
+    }
+    if(be16(data + offsetof(Elf32_Ehdr, e_machine)) != EM_MIPS
+            || be16(data + offsetof(Elf32_Ehdr, e_type)) != ET_EXEC) {
+        cerr << file << ": not a MIPS executable; link it statically" << endl;
+        return false;
+    }
+    entry = be32(data + offsetof(Elf32_Ehdr, e_entry));
+    uint32_t phoff = be32(data + offsetof(Elf32_Ehdr, e_phoff));
+    uint16_t phentsize = be16(data + offsetof(Elf32_Ehdr, e_phentsize));
+    uint16_t phnum = be16(data + offsetof(Elf32_Ehdr, e_phnum));
+    if(phentsize < sizeof(Elf32_Phdr) || phoff > length || (size_t) phnum * phentsize > length - phoff) {
+        cerr << file << ": truncated program header table" << endl;
+        return false;
+    }
+    for(uint16_t i = 0; i < phnum; i++) {
+        const unsigned char* ph = data + phoff + (size_t) i * phentsize;
+        if(be32(ph + offsetof(Elf32_Phdr, p_type)) != PT_LOAD)
+            continue;
+        ElfSegment s;
+        s.offset = be32(ph + offsetof(Elf32_Phdr, p_offset));
+        s.vaddr = be32(ph + offsetof(Elf32_Phdr, p_vaddr));
+        s.fileSize = be32(ph + offsetof(Elf32_Phdr, p_filesz));
+        s.memSize = be32(ph + offsetof(Elf32_Phdr, p_memsz));
+        s.executable = (be32(ph + offsetof(Elf32_Phdr, p_flags)) & PF_X) != 0;
+        if(s.offset > length || s.fileSize > length - s.offset || s.fileSize > s.memSize) {
+            cerr << file << ": segment outside of file" << endl;
+            return false;
+        }
+        if(s.vaddr % 4 != 0 || (ll) s.vaddr + s.memSize > 0x7fffffffLL - ELF_STACK_BYTES) {
+            cerr << file << ": segment at " << s.vaddr << " is unaligned or too high" << endl;
+            return false;
+        }
+        segments.push_back(s);
+        uint32_t top = s.vaddr + s.memSize;
+        end = max(end, (top + ELF_PAGE_BYTES - 1) / ELF_PAGE_BYTES * ELF_PAGE_BYTES);
+    }
+    if(segments.empty()) {
+        cerr << file << ": no loadable segments" << endl;
+        return false;
+    }
+    return true;
+}
+
+// $gp of code that addresses small data through it, from the symbol table
+void ElfFile::findGlobalPointer() {
+    uint32_t shoff = be32(data + offsetof(Elf32_Ehdr, e_shoff));
+    uint16_t shentsize = be16(data + offsetof(Elf32_Ehdr, e_shentsize));
+    uint16_t shnum = be16(data + offsetof(Elf32_Ehdr, e_shnum));
+    if(shoff == 0 || shentsize < sizeof(Elf32_Shdr) || shoff > length
+            || (size_t) shnum * shentsize > length - shoff)
+        return;
+    auto section = [&](uint32_t i) {
+        return data + shoff + (size_t) i * shentsize;
+    };
+    for(uint16_t i = 0; i < shnum; i++) {
+        const unsigned char* sh = section(i);
+        uint32_t link = be32(sh + offsetof(Elf32_Shdr, sh_link));
+        if(be32(sh + offsetof(Elf32_Shdr, sh_type)) != SHT_SYMTAB || link >= shnum)
+            continue;
+        uint32_t offset = be32(sh + offsetof(Elf32_Shdr, sh_offset));
+        uint32_t size = be32(sh + offsetof(Elf32_Shdr, sh_size));
+        uint32_t strOffset = be32(section(link) + offsetof(Elf32_Shdr, sh_offset));
+        uint32_t strSize = be32(section(link) + offsetof(Elf32_Shdr, sh_size));
+        if(offset > length || size > length - offset || strOffset > length || strSize > length - strOffset)
+            return;
+        for(uint32_t at = 0; at + sizeof(Elf32_Sym) <= size; at += sizeof(Elf32_Sym)) {
+            const unsigned char* sym = data + offset + at;
+            uint32_t name = be32(sym + offsetof(Elf32_Sym, st_name));
+            if(name + 4 <= strSize && memcmp(data + strOffset + name, "_gp", 4) == 0) {
+                globalPointer = be32(sym + offsetof(Elf32_Sym, st_value));
+                return;
+            }
+        }
+    }
+}
+
+ElfFile::~ElfFile() {
+    if(data != nullptr)
+        munmap((void*) data, length);
+    if(fd >= 0)
+        close(fd);
+}
+
+uint32_t ElfFile::word(const ElfSegment& segment, size_t i) const {
+    size_t at = (size_t) segment.offset + 4 * i;
+    unsigned char bytes[4] = {0, 0, 0, 0};
+    // the last word of a segment may be cut short by the file
+    memcpy(bytes, data + at, min((size_t) 4, (size_t) segment.offset + segment.fileSize - at));
+    return be32(bytes);
+}
+
+void ElfFile::fill(ll* memory, size_t size) const {
+    for(const ElfSegment& s : segments) {
+        size_t base = s.vaddr / 4, words = (s.fileSize + 3) / 4;
+        for(size_t i = 0; i < words && base + i < size; i++)
+            memory[base + i] = (int32_t) word(s, i);
+    }
+}
+
+size_t ElfFile::textWords() const {
+    size_t words = 0;
+    for(const ElfSegment& s : segments)
+        if(s.executable)
+            words = max(words, (size_t) (s.vaddr + s.fileSize + 3) / 4);
+    return words;
+}
+
+size_t ElfFile::memoryWords() const {
+    // offsets are unsigned 16-bit in the pipelines, so anything $sp can
+    // reach without changing it is inside
+    return ((size_t) end + ELF_STACK_BYTES + 0x10000) / 4;
+}
+
+ll ElfFile::stackPointer() const {
+    // 16 bytes below the end, where the program finds argc = 0 and argv = NULL
+    return (ll) end + ELF_STACK_BYTES - 16;
+}
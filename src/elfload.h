@@ -0,0 +1,75 @@
+#ifndef ELFLOAD_HEADER
+#define ELFLOAD_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Statically linked big-endian MIPS32 executables (ET_EXEC, EM_MIPS),
+    e.g. cross-compiled C kernels. The simulators accept one in place of
+    both input files, as they do a binary image:
+
+        proc_simN kernel.elf kernel.elf
+
+    Every PT_LOAD segment is copied into Memory at its virtual address, one
+    32-bit word per cell, sign-extended; the part of a segment past its
+    file size (.bss) stays zero. Executable segments also go into
+    InstructionMemory, which grows to the end of the last of them. The
+    stack is ELF_STACK_BYTES above the highest segment, and the program
+    starts at the entry point with $sp just below its top and $gp at the
+    _gp symbol, if the file has one. Memory ends 64 KB above $sp, the reach
+    of the unsigned offsets of lw and sw.
+
+    The pipelines only implement the instructions listed in instruction.h,
+    so kernels have to be compiled to that subset.
+*/
+
+#define ELF_STACK_BYTES (1 << 20)
+
+struct ElfSegment {
+    uint32_t vaddr, fileSize, memSize, offset;
+    bool executable;
+};
+
+class ElfFile {
+public:
+    /*
+        Maps the whole file read-only. valid is false, with the reason on
+        stderr, if it is not a MIPS32 big-endian executable.
+    */
+    ElfFile(string file);
+    ~ElfFile();
+    ElfFile(const ElfFile&) = delete;
+    ElfFile& operator=(const ElfFile&) = delete;
+
+    // the i-th 32-bit word of the file part of segment
+    uint32_t word(const ElfSegment& segment, size_t i) const;
+    // copies every segment into memory, size words from address 0
+    void fill(ll* memory, size_t size) const;
+
+    // the end of instruction memory and of Memory, in words
+    size_t textWords() const;
+    size_t memoryWords() const;
+    // the initial $sp
+    ll stackPointer() const;
+
+    bool valid = false;
+    int fd = -1;
+    const unsigned char* data = nullptr;
+    size_t length = 0;
+    uint32_t entry = 0;
+    uint32_t globalPointer = 0;     // _gp, 0 if there is none
+    uint32_t end = 0;               // of the highest segment, page aligned
+    vector<ElfSegment> segments;    // PT_LOAD only
+
+private:
+    bool parse(const string& file);
+    void findGlobalPointer();
+};
+
+bool isElfFile(string file);
+
+#endif
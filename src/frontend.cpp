@@ -0,0 +1,122 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "batch.h"
+#include "decoupled.h"
+#include "dump.h"
+#include "interval.h"
+#include "simulator.h"
+#include "textload.h"
+#define ll long long
+
+using namespace std;
+
+// the memory files listed in file, one per line
+static bool readBatchList(const string& file, vector<string>& memories, string& error) {
+    string text;
+    if(!readWholeFile(file, text)) {
+        error = "cannot read " + file + "\n";
+        return false;
+    }
+    istringstream lines(text);
+    string line;
+    while(getline(lines, line)) {
+        if(!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if(line == "")
+            continue;
+        if(!ifstream(line)) {
+            error = file + ": cannot read " + line + "\n";
+            return false;
+        }
+        memories.push_back(line);
+    }
+    return true;
+}
+
+// --batch: the program on <memory> and every listed memory
+static int batchMain(Simulator& sim, BatchPipeline batch) {
+    const Options& options = sim.options;
+    vector<string> files;
+    string error;
+    if(!readBatchList(options.batchFile, files, error)) {
+        cerr << error;
+        return 1;
+    }
+    sim.perf.begin(PHASE_LOAD);
+    vector<unique_ptr<Memory>> loaded;
+    vector<Memory*> memories = {&sim.memory()};
+    for(const string& file : files) {
+        loaded.push_back(make_unique<Memory>(file));
+        if(!loaded.back()->valid) {
+            cerr << options.batchFile << ": cannot load memory from " << file << endl;
+            return 1;
+        }
+        memories.push_back(loaded.back().get());
+    }
+    sim.perf.end(PHASE_LOAD);
+
+    string blocker = batchBlocker(options, *sim.IMEM);
+    if(blocker != "")
+        cerr << "not in a batch: " << blocker << endl;
+    BatchStats stats;
+    vector<SimResult> results = batch(options, *sim.IMEM, memories, sim.perf, &stats);
+    if(blocker == "")
+        reportBatch(cerr, stats, memories.size());
+
+    sim.perf.begin(PHASE_DUMP);
+    ll cycles = 0, instructions = 0;
+    bool written = true;
+    for(size_t i = 0; i < results.size(); i++) {
+        string file = options.dumpFile == "" || i == 0 ? options.dumpFile : options.dumpFile + "." + to_string(i);
+        written &= writeLogs(results[i].cycles, results[i].instructions, results[i].rf, *memories[i],
+                options.dump, file);
+        cycles += results[i].cycles;
+        instructions += results[i].instructions;
+    }
+    sim.perf.end(PHASE_DUMP);
+    if(options.perf)
+        sim.perf.report(cerr, cycles, instructions);
+    return written ? 0 : 1;
+}
+
+int simulatorMain(int argc, char* argv[], CoreFactory pipeline, Pipeline decoupled, BatchPipeline batch) {
+    Simulator sim(pipeline, Options(argc, argv));
+    const Options& options = sim.options;
+    string error;
+    sim.perf.begin(PHASE_LOAD);
+    if(!sim.loadFiles(options.program, options.memory, error)) {
+        cerr << error;
+        return 1;
+    }
+    sim.perf.end(PHASE_LOAD);
+    if(options.batchFile != "")
+        return batchMain(sim, batch);
+
+    SimResult result;
+    bool intervals = options.interval > 0;
+    string blocker = intervals ? intervalBlocker(options, *sim.IMEM)
+            : options.decoupled ? decoupleBlocker(options, *sim.IMEM) : "";
+    if(intervals && blocker == "") {
+        vector<Interval> report;
+        result = runIntervals(pipeline, options, *sim.IMEM, sim.memory(), sim.perf, &report);
+        reportIntervals(cerr, report, result.cycles, result.instructions);
+    }
+    else if(options.decoupled && blocker == "")
+        result = decoupled(options, *sim.IMEM, sim.memory(), sim.perf);
+    else {
+        if(intervals || options.decoupled)
+            cerr << (intervals ? "not in intervals: " : "not decoupled: ") << blocker << endl;
+        sim.run();
+        result = sim.finish();
+        sim.report(cerr);
+    }
+
+    sim.perf.begin(PHASE_DUMP);
+    bool written = writeLogs(result.cycles, result.instructions, result.rf, sim.memory(), options.dump,
+            options.dumpFile);
+    sim.perf.end(PHASE_DUMP);
+    if(options.perf)
+        sim.perf.report(cerr, result.cycles, result.instructions);
+    return written ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+#include "hooks.h"
+#define ll long long
+
+using namespace std;
+
+void MemoryHooks::watch(ll begin, ll end) {
+    watchpoints.push_back({begin, end, 0});
+    active = true;
+}
+
+void MemoryHooks::onAccess(function<void(const MemoryAccess&)> callback) {
+    callbacks.push_back(callback);
+    active = true;
+}
+
+void MemoryHooks::dispatch(const MemoryAccess& access) {
+    for(Watchpoint& w : watchpoints) {
+        if(access.address >= w.begin && access.address < w.end) {
+            w.hits++;
+            *log << "watch: cycle " << access.cycle << " pc " << access.pc << " "
+                << (access.store ? "store " : "load ") << access.address
+                << " = " << access.value << endl;
+        }
+    }
+    for(function<void(const MemoryAccess&)>& callback : callbacks)
+        callback(access);
+}
+
+void MemoryHooks::report(ostream& out) {
+    out << "Memory loads: " << loads << endl;
+    out << "Memory stores: " << stores << endl;
+    for(Watchpoint& w : watchpoints)
+        out << "Watchpoint [" << w.begin << ", " << w.end << "): " << w.hits << " hits" << endl;
+}
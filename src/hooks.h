@@ -0,0 +1,68 @@
+#ifndef HOOKS_HEADER
+#define HOOKS_HEADER
+
+#include <functional>
+#include <iostream>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Hooks on the data memory load and store paths. The simulation loop is a
+    template over the hook type and guards every call with
+    "if constexpr (Hooks::enabled)", so a run with NoHooks compiles to the
+    same code as having no hooks at all.
+*/
+
+struct MemoryAccess {
+    bool store;
+    ll address;     // byte address
+    ll value;
+    ll pc;          // PC of the load or store instruction
+    ll cycle;
+};
+
+class NoHooks {
+public:
+    static constexpr bool enabled = false;
+    void load(ll, ll, ll, ll) {}
+    void store(ll, ll, ll, ll) {}
+};
+
+class MemoryHooks {
+public:
+    static constexpr bool enabled = true;
+
+    struct Watchpoint {
+        ll begin, end;  // byte addresses, [begin, end)
+        ll hits;
+    };
+
+    void watch(ll begin, ll end);
+    void onAccess(function<void(const MemoryAccess&)> callback);
+
+    inline void load(ll address, ll value, ll pc, ll cycle) {
+        loads++;
+        if(active)
+            dispatch({false, address, value, pc, cycle});
+    }
+
+    inline void store(ll address, ll value, ll pc, ll cycle) {
+        stores++;
+        if(active)
+            dispatch({true, address, value, pc, cycle});
+    }
+
+    void report(ostream& out);
+
+    ll loads = 0, stores = 0;
+    vector<Watchpoint> watchpoints;
+    ostream* log = &cerr;   // where watchpoint hits are printed
+
+private:
+    void dispatch(const MemoryAccess& access);
+    bool active = false;    // any watchpoint or callback registered
+    vector<function<void(const MemoryAccess&)>> callbacks;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+#define ll long long
+
+using namespace std;
+
+// Image fields and payload words are read in place, which is only correct
+// on a little-endian host.
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "binary images require a little-endian host"
+#endif
+
+static_assert(sizeof(ImageHeader) == 24, "ImageHeader layout");
+static_assert(sizeof(ImageSegment) == 32, "ImageSegment layout");
+static_assert(sizeof(ll) == 8, "Memory cells are 64-bit words");
+
+bool isImageFile(string file) {
+    char magic[8] = {0};
+    ifstream myfile (file, ios::binary);
+    if(!myfile.read(magic, 8))
+        return false;
+    return memcmp(magic, IMAGE_MAGIC, 8) == 0;
+}
+
+ImageFile::ImageFile(string file) {
+    fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+        cerr << file << ": cannot read image" << endl;
+        return;
+    }
+    if((size_t) st.st_size < sizeof(ImageHeader)) {
+        cerr << file << ": truncated image header" << endl;
+        return;
+    }
+    length = st.st_size;
+    void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(p == MAP_FAILED) {
+        length = 0;
+        return;
+    }
+    data = (const char*) p;
+
+    ImageHeader header;
+    memcpy(&header, data, sizeof(header));
+    if(memcmp(header.magic, IMAGE_MAGIC, 8) != 0 || header.version != IMAGE_VERSION) {
+        cerr << file << ": not a version " << IMAGE_VERSION << " image" << endl;
+        return;
+    }
+    if(header.memoryWords > IMAGE_MAX_MEMORY_WORDS) {
+        cerr << file << ": memory of " << header.memoryWords << " words is larger than "
+                << IMAGE_MAX_MEMORY_WORDS << endl;
+        return;
+    }
+    size_t tableEnd = sizeof(ImageHeader) + (size_t) header.segmentCount * sizeof(ImageSegment);
+    if(tableEnd > length) {
+        cerr << file << ": truncated segment table" << endl;
+        return;
+    }
+    segments.resize(header.segmentCount);
+    memcpy(segments.data(), data + sizeof(ImageHeader), header.segmentCount * sizeof(ImageSegment));
+    for(ImageSegment& s : segments) {
+        if(s.offset % 8 != 0 || s.offset > length || s.length > (length - s.offset) / 8) {
+            cerr << file << ": segment outside of file" << endl;
+            segments.clear();
+            return;
+        }
+        // writeImage keeps data within memoryWords and text from address 0
+        uint64_t limit = s.kind == DATA_SEGMENT ? header.memoryWords : IMAGE_MAX_TEXT_WORDS;
+        if((s.kind != TEXT_SEGMENT && s.kind != DATA_SEGMENT) || s.base > limit || s.length > limit - s.base) {
+            cerr << file << ": segment outside of the address space of the image" << endl;
+            segments.clear();
+            return;
+        }
+    }
+    memoryWords = header.memoryWords;
+    valid = true;
+}
+
+ImageFile::~ImageFile() {
+    if(data != nullptr)
+        munmap((void*) data, length);
+    if(fd >= 0)
+        close(fd);
+}
+
+const ll* ImageFile::words(const ImageSegment& segment) const {
+    return (const ll*) (data + segment.offset);
+}
+
+void ImageFile::mapData(ll* dest, size_t size, bool allowMap) const {
+    size_t page = sysconf(_SC_PAGESIZE);
+    for(const ImageSegment& s : segments) {
+        if(s.kind != DATA_SEGMENT || s.base >= size)
+            continue;
+        size_t words = min((size_t) s.length, size - (size_t) s.base);
+        size_t bytes = words * 8;
+        ll* target = dest + s.base;
+        /*
+            Whole pages are mapped privately from the file, so they are
+            shared with the page cache until the simulation stores into them.
+            Anything not page-aligned (or the tail of a segment) is copied.
+        */
+        size_t mapped = 0;
+        if(allowMap && ((size_t) target) % page == 0 && s.offset % page == 0) {
+            mapped = bytes - bytes % page;
+            if(mapped > 0 && mmap(target, mapped, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_FIXED, fd, s.offset) == MAP_FAILED)
+                mapped = 0;
+        }
+        memcpy((char*) target + mapped, data + s.offset + mapped, bytes - mapped);
+    }
+}
+
+static void pad(ofstream& out, uint64_t& offset) {
+    static const char zeros[IMAGE_PAGE_BYTES] = {0};
+    uint64_t aligned = (offset + IMAGE_PAGE_BYTES - 1) / IMAGE_PAGE_BYTES * IMAGE_PAGE_BYTES;
+    out.write(zeros, aligned - offset);
+    offset = aligned;
+}
+
+bool writeImage(string file, const vector<ll>& text, const ll* data, size_t dataWords) {
+    vector<ImageSegment> segments;
+    if(!text.empty())
+        segments.push_back({TEXT_SEGMENT, 0, 0, text.size(), 0});
+
+    // one data segment per run of pages that contain a non-zero word
+    size_t pages = (dataWords + IMAGE_PAGE_WORDS - 1) / IMAGE_PAGE_WORDS;
+    for(size_t p = 0; p < pages; p++) {
+        size_t start = p * IMAGE_PAGE_WORDS;
+        size_t end = min(start + IMAGE_PAGE_WORDS, dataWords);
+        bool used = false;
+        for(size_t i = start; i < end && !used; i++)
+            used = data[i] != 0;
+        if(!used)
+            continue;
+        if(!segments.empty() && segments.back().kind == DATA_SEGMENT
+                && segments.back().base + segments.back().length == start)
+            segments.back().length += end - start;
+        else
+            segments.push_back({DATA_SEGMENT, 0, start, end - start, 0});
+    }
+
+    ImageHeader header;
+    memcpy(header.magic, IMAGE_MAGIC, 8);
+    header.version = IMAGE_VERSION;
+    header.segmentCount = segments.size();
+    header.memoryWords = dataWords;
+
+    uint64_t offset = sizeof(ImageHeader) + segments.size() * sizeof(ImageSegment);
+    for(ImageSegment& s : segments) {
+        offset = (offset + IMAGE_PAGE_BYTES - 1) / IMAGE_PAGE_BYTES * IMAGE_PAGE_BYTES;
+        s.offset = offset;
+        offset += s.length * 8;
+    }
+
+    ofstream out (file, ios::binary | ios::trunc);
+    if(!out) {
+        cerr << file << ": cannot open for writing" << endl;
+        return false;
+    }
+    out.write((const char*) &header, sizeof(header));
+    out.write((const char*) segments.data(), segments.size() * sizeof(ImageSegment));
+    offset = sizeof(ImageHeader) + segments.size() * sizeof(ImageSegment);
+    for(ImageSegment& s : segments) {
+        pad(out, offset);
+        const ll* words = s.kind == TEXT_SEGMENT ? text.data() : data + s.base;
+        out.write((const char*) words, s.length * 8);
+        offset += s.length * 8;
+    }
+    // a failed write stays in the stream state; close flushes what is buffered
+    out.close();
+    if(!out) {
+        cerr << file << ": cannot write image" << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef IMAGE_HEADER
+#define IMAGE_HEADER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Binary program/memory image.
+
+    The text formats (one decimal instruction per line, "pos-val" memory
+    lines) have to be parsed on every run. An image stores the same words
+    in the layout the simulator keeps them in, so the loader can mmap the
+    file and map data segments straight into Memory without parsing.
+
+    Layout, all fields little-endian:
+        header   : char magic[8] = "MIPSIMG", u32 version, u32 segmentCount,
+                   u64 memoryWords
+        segments : segmentCount x ImageSegment
+        payload  : 64-bit words (the width of a Memory cell). Segments are
+                   written at page-aligned offsets so they can be mapped
+                   copy-on-write.
+
+    Segment bases and lengths are in words, offsets in bytes.
+*/
+
+#define IMAGE_MAGIC "MIPSIMG"
+#define IMAGE_VERSION 1
+#define IMAGE_PAGE_BYTES 4096
+#define IMAGE_PAGE_WORDS (IMAGE_PAGE_BYTES / 8)
+// a text segment ends below this word address, the 32-bit address space
+#define IMAGE_MAX_TEXT_WORDS (1ull << 30)
+// and memoryWords is at most this, for the same reason
+#define IMAGE_MAX_MEMORY_WORDS (1ull << 30)
+
+enum SegmentKind {TEXT_SEGMENT = 0, DATA_SEGMENT = 1};
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t segmentCount;
+    uint64_t memoryWords;
+};
+
+struct ImageSegment {
+    uint32_t kind;
+    uint32_t flags;     // reserved, written as 0
+    uint64_t base;
+    uint64_t length;
+    uint64_t offset;
+};
+
+class ImageFile {
+public:
+    /*
+        Maps the whole file read-only. valid is false, with the reason on
+        stderr, if the file could not be opened, is not an image of a
+        supported version or its header and segments do not fit together.
+    */
+    ImageFile(string file);
+    ~ImageFile();
+    ImageFile(const ImageFile&) = delete;
+    ImageFile& operator=(const ImageFile&) = delete;
+
+    const ll* words(const ImageSegment& segment) const;
+    /*
+        Copies or maps the data segments into dest, a page-aligned region of
+        size words. With allowMap false everything is copied, for destinations
+        that must not be replaced by a file mapping.
+    */
+    void mapData(ll* dest, size_t size, bool allowMap = true) const;
+
+    bool valid = false;
+    int fd = -1;
+    const char* data = nullptr;
+    size_t length = 0;
+    uint64_t memoryWords = 0;
+    vector<ImageSegment> segments;
+};
+
+bool isImageFile(string file);
+// text holds instruction words from address 0, data is the initial memory;
+// false, with the reason on stderr, if file could not be completely written
+bool writeImage(string file, const vector<ll>& text, const ll* data, size_t dataWords);
+
+#endif
@@ -26,94 +26,98 @@ bool matches(vector<int>& bin, int start, int end, string s){
     return true;
 }
 
+/*
+    The predicates and getters below used to go through toBinary and
+    matches, which allocate a vector per call and dominated the run time.
+    They now read the fields with shifts; bits are still numbered from the
+    most significant bit of the 32-bit word as in toBinary.
+*/
+static inline ll field(ll instruction, int start, int end) {
+    return (instruction >> (32 - end)) & ((1LL << (end - start)) - 1);
+}
+
+static inline int opcode(ll instruction) {
+    return field(instruction, 0, 6);
+}
+
+static inline int funct(ll instruction) {
+    return field(instruction, 26, 32);
+}
+
 bool isRType(ll instruction) {
-    vector<int> bin = toBinary(instruction);
     // jr is not considered to be an R type instruction here
-    return (matches(bin, 0, 6, "000000") && 
-        !(matches(bin, 26, 32, "001000") || 
-        matches(bin, 0, 32, "00000000000000000000000000000000")));
+    return opcode(instruction) == 0 && !(funct(instruction) == 0x08 || isNoop(instruction));
 }
 
 bool isLoad(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "100011");
+    return opcode(instruction) == 0x23;
 }
 
 bool isStore(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "101011");
+    return opcode(instruction) == 0x2b;
 }
 
 bool isBranch(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000100") || matches(bin, 0, 6, "000101");
+    return opcode(instruction) == 0x04 || opcode(instruction) == 0x05;
 }
 
 
 bool isBEQ(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000100");
+    return opcode(instruction) == 0x04;
 }
 
 bool isBNE(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000101");
+    return opcode(instruction) == 0x05;
 }
 
 bool isJump(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000010");
+    return opcode(instruction) == 0x02;
 }
 
 bool isJAL(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000011");
+    return opcode(instruction) == 0x03;
 }
 
 bool isJR(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000000") && matches(bin, 26, 32, "001000");
+    return opcode(instruction) == 0 && funct(instruction) == 0x08;
 }
 
 bool isNoop(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 32, "00000000000000000000000000000000");
+    return (instruction & 0xffffffffLL) == 0;
 }
 
 bool isLUI(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "001111");
+    return opcode(instruction) == 0x0f;
 }
 
 bool isSLL(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000000") && matches(bin, 26, 32, "000000");
+    return opcode(instruction) == 0 && funct(instruction) == 0x00;
 }
 
 bool isSRL(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return matches(bin, 0, 6, "000000") && matches(bin, 26, 32, "000010");
+    return opcode(instruction) == 0 && funct(instruction) == 0x02;
 }
 
 Operation getOperation(ll instruction) {
     // It is assumed already that the instruction is an R-type instruction
-    vector<int> bin = toBinary(instruction);
-    if(matches(bin, 26, 32, "100000"))
+    int f = funct(instruction);
+    if(f == 0x20)
         return ADD;
-    else if(matches(bin, 26, 32, "100010"))
+    else if(f == 0x22)
         return SUB;
-    else if(matches(bin, 26, 32, "100101"))
+    else if(f == 0x25)
         return OR;
-    else if(matches(bin, 26, 32, "101010"))
+    else if(f == 0x2a)
         return SLT;
-    else if(matches(bin, 26, 32, "100100"))
+    else if(f == 0x24)
         return AND;
-    else if(matches(bin, 0, 32, "00000000000000000000000000000000"))
+    else if(isNoop(instruction))
         return NOOP;
-    else if(matches(bin, 26, 32, "000000"))
+    else if(f == 0x00)
         return SLL;
-    else if(matches(bin, 26, 32, "000010"))
+    else if(f == 0x02)
         return SRL;
+    return NOOP;
 }
 
 ll toDecimal(vector<int> instruction, int start, int end) {
@@ -128,69 +132,61 @@ ll toDecimal(vector<int> instruction, int start, int end) {
 }
 
 ll getWriteOffset(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return toDecimal(bin, 16, 32);
+    return field(instruction, 16, 32);
 }
 
 ll getBranchOffset(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return toDecimal(bin, 16, 32);
+    return field(instruction, 16, 32);
 }
 
 ll getJumpOffset(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return toDecimal(bin, 6, 32);
+    return field(instruction, 6, 32);
 }
 
 ll getRS(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return toDecimal(bin, 6, 11);
+    return field(instruction, 6, 11);
 }
 
 ll getRT(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return toDecimal(bin, 11, 16);
+    return field(instruction, 11, 16);
 }
 
 ll getRD(ll instruction) {
-    vector<int> bin = toBinary(instruction);
-    return toDecimal(bin, 16, 21);
+    return field(instruction, 16, 21);
 }
 
-vector<ll> getReadReg(ll instruction) {
-    // assert: instruction is not NOOP
-    vector<int> bin = toBinary(instruction);
+// the registers getReadReg returns, without the vector; returns how many
+static int readRegisters(ll instruction, ll regs[2]) {
     if(isRType(instruction) || isStore(instruction) || isBranch(instruction)) {
         // separate case required for sll. 
         if(isSLL(instruction) || isSRL(instruction)) {
-            ll rt = toDecimal(bin, 11, 16);
-            return vector<ll>({rt});
+            regs[0] = getRT(instruction);
+            return 1;
         }
-        ll rs = toDecimal(bin, 6, 11);
-        ll rt = toDecimal(bin, 11, 16);
-        return vector<ll>({rs, rt});
+        regs[0] = getRS(instruction);
+        regs[1] = getRT(instruction);
+        return 2;
     }
     else if(isLoad(instruction) || isJR(instruction)) {
-        ll base = toDecimal(bin, 6, 11);
-        return vector<ll>({base});
+        regs[0] = getRS(instruction);
+        return 1;
     }
-    else if(isJump(instruction) || isJAL(instruction) || isLUI(instruction)) {
-        return vector<ll>();
-    }
-    return vector<ll>();
+    return 0;
+}
+
+vector<ll> getReadReg(ll instruction) {
+    // assert: instruction is not NOOP
+    ll regs[2];
+    int n = readRegisters(instruction, regs);
+    return vector<ll>(regs, regs + n);
 }
 
 ll getWriteReg(ll instruction) {
     // assert: instruction is not NOOP
-    vector<int> bin = toBinary(instruction);
-    if(isRType(instruction)) {
-        ll rd = toDecimal(bin, 16, 21);
-        return rd;
-    }
-    else if(isLoad(instruction) || isLUI(instruction)) {
-        ll rt = toDecimal(bin, 11, 16);
-        return rt;
-    }
+    if(isRType(instruction))
+        return getRD(instruction);
+    else if(isLoad(instruction) || isLUI(instruction))
+        return getRT(instruction);
     else
         return -1;
 }
@@ -200,9 +196,10 @@ ll hazardExists(ll i1, ll i2) {
     if(isNoop(i1) || isNoop(i2))
         return false;
     else {
-        vector<ll> readReg1 = getReadReg(i1);
+        ll readReg1[2];
+        int n = readRegisters(i1, readReg1);
         ll writeReg2 = getWriteReg(i2);
-        for(int i = 0; i < readReg1.size(); i++) {
+        for(int i = 0; i < n; i++) {
             if(readReg1[i] == writeReg2)
                 return true;
         }
@@ -216,6 +213,33 @@ bool writes(ll instruction, int reg) {
 }
 
 bool reads(ll instruction, int reg) {
-    vector<ll> rd = getReadReg(instruction);
-    return find(rd.begin(), rd.end(), reg) != rd.end();
+    ll rd[2];
+    int n = readRegisters(instruction, rd);
+    return find(rd, rd + n, (ll) reg) != rd + n;
+}
+
+string mnemonic(ll instruction) {
+    if(isNoop(instruction))
+        return "nop";
+    if(isRType(instruction)) {
+        static const char* ops[] = {"add", "sub", "and", "or", "slt", "sll", "srl", "nop"};
+        return ops[getOperation(instruction)];
+    }
+    if(isLoad(instruction))
+        return "lw";
+    if(isStore(instruction))
+        return "sw";
+    if(isBEQ(instruction))
+        return "beq";
+    if(isBNE(instruction))
+        return "bne";
+    if(isJump(instruction))
+        return "j";
+    if(isJAL(instruction))
+        return "jal";
+    if(isJR(instruction))
+        return "jr";
+    if(isLUI(instruction))
+        return "lui";
+    return "?";
 }
\ No newline at end of file
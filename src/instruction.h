@@ -38,5 +38,6 @@ ll getRD(ll instruction);
 vector<ll> getReadReg(ll instruction);
 ll getWriteReg(ll instruction);
 ll hazardExists(ll i1, ll i2);
+string mnemonic(ll instruction);
 
 #endif
\ No newline at end of file
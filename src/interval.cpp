@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "decoupled.h"
+#include "instruction.h"
+#include "interval.h"
+#include "reference.h"
+#define ll long long
+
+using namespace std;
+
+// instructions over which the warm-up error is measured if warmup is shorter
+#define MIN_OVERLAP 100
+
+// what an interval's thread measured, in cycles of its own run
+struct Measured {
+    bool valid = false;     // the program reached the end of the warm-up
+    ll cycles = 0, instructions = 0;
+    ll coldOverlap = 0;     // the first overlap instructions of the interval
+    ll warmOverlap = 0;     // the first overlap instructions of the next one
+    double seconds = 0;
+};
+
+struct Checkpoint {
+    ll position = 0;        // instructions executed before it
+    ll warmup = 0;          // instructions from it to the interval
+    ll PC = 0;
+    vector<ll> rf;
+    unsigned seed = 0;      // rand_r state of proc_sim3
+    // every page stored to so far; unchanged pages are shared with the
+    // checkpoint before
+    vector<pair<size_t, shared_ptr<const vector<ll>>>> pages;
+    Measured measured;
+};
+
+string intervalBlocker(const Options& options, const InstructionMemory& IMEM) {
+    string blocker = decoupleBlocker(options, IMEM);
+    if(blocker != "")
+        return blocker;
+    bool noop = false;
+    for(int i = 0; i < IMEM.count; i++) {
+        if(noop && !isNoop(IMEM.imem[i]))
+            return "the program has a noop before its end, where the pipeline may fetch on";
+        noop = noop || isNoop(IMEM.imem[i]);
+    }
+    return "";
+}
+
+/*
+    Runs the pipeline from cp until overlap instructions past the end of
+    its interval of length instructions, or until the program halts.
+*/
+static void simulate(CoreFactory pipeline, const Options& base, InstructionMemory& IMEM,
+        shared_ptr<const MemoryImage> initial, Checkpoint& cp, ll length, ll overlap) {
+    auto started = chrono::steady_clock::now();
+    Options options = base;
+    options.seed = cp.seed;
+    HostPerf perf(false);
+    Memory MEM(initial);
+    for(const pair<size_t, shared_ptr<const vector<ll>>>& page : cp.pages) {
+        size_t index = page.first << MEM.pageShift;
+        for(ll word : *page.second)
+            MEM.store(index++, word);
+    }
+    unique_ptr<Core> core = pipeline(options, IMEM, MEM, perf);
+    core->restore(cp.PC, cp.rf);
+
+    /*
+        The cycle in which the target-th instruction of this run retired,
+        or the last cycle if the program halts before. At most one
+        instruction retires per cycle, so running as many cycles as there
+        are instructions left cannot overshoot.
+    */
+    auto until = [&](ll target) {
+        ll retired;
+        while(!core->halted() && (retired = core->counters().instructions) < target)
+            core->run(target - retired);
+        return core->counters().cycles;
+    };
+    Measured& m = cp.measured;
+    ll start = until(cp.warmup);
+    m.valid = core->counters().instructions >= cp.warmup;
+    ll coldEnd = until(cp.warmup + overlap);
+    ll end = until(cp.warmup + length);
+    m.instructions = core->counters().instructions - cp.warmup;
+    ll warmEnd = until(cp.warmup + length + overlap);
+    m.cycles = end - start;
+    m.coldOverlap = coldEnd - start;
+    m.warmOverlap = warmEnd - end;
+    m.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+}
+
+SimResult runIntervals(CoreFactory pipeline, const Options& options, InstructionMemory& IMEM,
+        Memory& MEM, HostPerf& perf, vector<Interval>* intervals) {
+    if(options.interval <= 0 || intervalBlocker(options, IMEM) != "")
+        return runCore(pipeline, options, IMEM, MEM, perf);
+
+    perf.begin(PHASE_SIMULATE);
+    const ll length = options.interval, warmup = max(0LL, options.warmup);
+    const ll overlap = min(length, max(warmup, (ll) MIN_OVERLAP));
+    auto position = [&](size_t i) {
+        return max(0LL, (ll) i * length - warmup);
+    };
+    shared_ptr<const MemoryImage> initial = make_shared<const MemoryImage>(MEM.memory, MEM.size);
+
+    mutex lock;
+    condition_variable ready;
+    vector<unique_ptr<Checkpoint>> checkpoints;
+    bool done = false;
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        while(true) {
+            size_t i = next++;
+            Checkpoint* cp;
+            {
+                unique_lock<mutex> guard(lock);
+                ready.wait(guard, [&]() { return checkpoints.size() > i || done; });
+                if(checkpoints.size() <= i)
+                    return;
+                cp = checkpoints[i].get();
+            }
+            simulate(pipeline, options, IMEM, initial, *cp, length, overlap);
+        }
+    };
+    int threads = options.threads > 0 ? options.threads : max(1u, thread::hardware_concurrency());
+    vector<thread> pool;
+    for(int t = 0; t < threads; t++)
+        pool.emplace_back(worker);
+
+    // the functional pass, on this thread
+    SimResult result;
+    vector<ll>& rf = result.rf;
+    rf = vector<ll>(32, 0);
+    ll PC = 0, executed = 0;
+    unsigned seed = options.seed >= 0 ? options.seed : time(NULL);
+    size_t pageWords = (size_t) 1 << MEM.pageShift;
+    map<size_t, shared_ptr<const vector<ll>>> pages;
+    while(true) {
+        while(executed == position(checkpoints.size())) {
+            unique_ptr<Checkpoint> cp(new Checkpoint());
+            cp->position = executed;
+            cp->warmup = (ll) checkpoints.size() * length - executed;
+            cp->PC = PC;
+            cp->rf = rf;
+            cp->seed = seed;
+            for(size_t page : MEM.dirtyPages) {
+                const ll* words = MEM.memory + page * pageWords;
+                size_t count = min(pageWords, MEM.size - page * pageWords);
+                shared_ptr<const vector<ll>>& copy = pages[page];
+                if(copy == nullptr || !equal(words, words + count, copy->begin()))
+                    copy = make_shared<const vector<ll>>(words, words + count);
+            }
+            cp->pages.assign(pages.begin(), pages.end());
+            {
+                lock_guard<mutex> guard(lock);
+                checkpoints.push_back(move(cp));
+            }
+            ready.notify_all();
+        }
+        size_t index = PC / 4;
+        ll instruction = PC >= 0 && index < IMEM.imem.size() ? IMEM.imem[index] : 0;
+        if(isNoop(instruction))
+            break;
+        // proc_sim3 draws once for every load that reaches EXMEM
+        if(isLoad(instruction))
+            rand_r(&seed);
+        PC = executeInstruction(instruction, PC, rf, MEM);
+        executed++;
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        done = true;
+    }
+    ready.notify_all();
+    for(thread& t : pool)
+        t.join();
+    perf.end(PHASE_SIMULATE);
+
+    result.instructions = executed;
+    const Measured* previous = nullptr;
+    for(const unique_ptr<Checkpoint>& cp : checkpoints) {
+        const Measured& m = cp->measured;
+        if(!m.valid)
+            break;
+        Interval interval;
+        interval.start = cp->position + cp->warmup;
+        interval.instructions = m.instructions;
+        interval.cycles = m.cycles;
+        interval.error = previous != nullptr ? m.coldOverlap - previous->warmOverlap : 0;
+        interval.seconds = m.seconds;
+        result.cycles += m.cycles;
+        if(intervals != nullptr)
+            intervals->push_back(interval);
+        previous = &m;
+    }
+    return result;
+}
+
+SimResult runIntervalsProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runIntervals(newProcSim1, options, IMEM, MEM, perf);
+}
+
+SimResult runIntervalsProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runIntervals(newProcSim2, options, IMEM, MEM, perf);
+}
+
+SimResult runIntervalsProcSim3(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runIntervals(newProcSim3, options, IMEM, MEM, perf);
+}
+
+void reportIntervals(ostream& out, const vector<Interval>& intervals, ll cycles, ll instructions) {
+    char line[160];
+    snprintf(line, sizeof(line), "%8s %12s %12s %12s %8s %9s\n",
+             "interval", "start", "instructions", "cycles", "error", "host s");
+    out << line;
+    ll error = 0;
+    for(size_t i = 0; i < intervals.size(); i++) {
+        const Interval& v = intervals[i];
+        snprintf(line, sizeof(line), "%8zu %12lld %12lld %12lld %8lld %9.3f\n",
+                 i, v.start, v.instructions, v.cycles, v.error, v.seconds);
+        out << line;
+        error += llabs(v.error);
+    }
+    snprintf(line, sizeof(line), "%lld cycles estimated for %lld instructions in %zu intervals, "
+             "warm-up error %lld cycles (%.4f%%)\n", cycles, instructions, intervals.size(), error,
+             cycles ? 100.0 * error / cycles : 0.0);
+    out << line;
+}
@@ -0,0 +1,63 @@
+#ifndef INTERVAL_HEADER
+#define INTERVAL_HEADER
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "simulator.h"
+#define ll long long
+using namespace std;
+
+/*
+    Interval-parallel runs split one long simulation by instruction count.
+    A functional pass executes the program as the model in reference.h
+    does and drops a checkpoint of the architectural state (PC, registers,
+    the pages stored to so far and the random stream of proc_sim3) warmup
+    instructions before every multiple of Options::interval. Each interval
+    then runs on the full pipeline on its own thread from its checkpoint:
+    the first warmup instructions fill the empty pipeline and are not
+    counted, the cycles between the retirement of the instruction before
+    the interval and that of its last one are. The cycle estimate of the
+    run is the sum over the intervals. Intervals start as soon as their
+    checkpoint exists, so the functional pass overlaps with them.
+
+    proc_sim3 draws one random number per load in program order, so the
+    functional pass can hand every interval the stream the serial run would
+    have; with enough warm-up the estimate is then exact for all three
+    pipelines. To show whether it was, every interval also runs on into the
+    next one for warmup instructions, but at least 100, and the next
+    interval's cycles over that overlap minus these warm ones are reported
+    as its error.
+
+    The final registers and memory are those of the functional pass, so an
+    interval run is refused under the conditions of decoupleBlocker, and
+    also when the program has a noop before its last instruction, past
+    which the pipeline may fetch while the functional pass would stop.
+*/
+
+struct Interval {
+    ll start = 0;               // instructions before the interval
+    ll instructions = 0;
+    ll cycles = 0;
+    ll error = 0;               // cycles over the overlap, cold minus warm
+    double seconds = 0;         // host time of its thread
+};
+
+// why an interval run would not match the pipeline, empty if it would
+string intervalBlocker(const Options& options, const InstructionMemory& IMEM);
+
+/*
+    An interval run of pipeline, or a serial one if intervalBlocker objects
+    or Options::interval is 0. intervals, if given, receives the intervals.
+*/
+SimResult runIntervals(CoreFactory pipeline, const Options& options, InstructionMemory& IMEM,
+        Memory& MEM, HostPerf& perf, vector<Interval>* intervals = nullptr);
+
+SimResult runIntervalsProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+SimResult runIntervalsProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+SimResult runIntervalsProcSim3(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+
+// one line per interval and the total, for stderr
+void reportIntervals(ostream& out, const vector<Interval>& intervals, ll cycles, ll instructions);
+
+#endif
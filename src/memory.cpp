@@ -0,0 +1,234 @@
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "elfload.h"
+#include "image.h"
+#include "memory.h"
+#include "textload.h"
+#define ll long long
+
+using namespace std;
+
+InstructionMemory::InstructionMemory(string file) {
+    imem = vector<ll>(IMEM_SIZE, 0);
+    if(isImageFile(file)) {
+        ImageFile image(file);
+        valid = image.valid;
+        for(const ImageSegment& s : image.segments) {
+            if(s.kind != TEXT_SEGMENT)
+                continue;
+            if(s.base + s.length + IMEM_PADDING > imem.size())
+                imem.resize(s.base + s.length + IMEM_PADDING, 0);
+            const ll* words = image.words(s);
+            copy(words, words + s.length, imem.begin() + s.base);
+            count = max(count, (int) (s.base + s.length));
+        }
+        return;
+    }
+    if(isElfFile(file)) {
+        ElfFile elf(file);
+        valid = elf.valid;
+        if(!valid)
+            return;
+        imem.resize(max(imem.size(), elf.textWords() + IMEM_PADDING), 0);
+        for(const ElfSegment& s : elf.segments)
+            if(s.executable)
+                for(size_t i = 0; i < (s.fileSize + 3) / 4; i++)
+                    imem[s.vaddr / 4 + i] = elf.word(s, i);
+        count = elf.textWords();
+        entry = elf.entry;
+        stackPointer = elf.stackPointer();
+        globalPointer = elf.globalPointer;
+        return;
+    }
+
+    string buffer;
+    if(!readWholeFile(file, buffer)) {
+        cerr << file << ": cannot read instructions" << endl;
+        valid = false;
+        return;
+    }
+    vector<ll> words;
+    if(size_t line = parseInstructions(buffer, words)) {
+        cerr << file << ":" << line << ": not a decimal instruction" << endl;
+        valid = false;
+        return;
+    }
+    count = words.size();
+    if(words.size() + IMEM_PADDING > imem.size())
+        imem.resize(words.size() + IMEM_PADDING, 0);
+    copy(words.begin(), words.end(), imem.begin());
+}
+
+InstructionMemory::InstructionMemory(const vector<ll>& words) : InstructionMemory(words.data(), words.size()) {}
+
+InstructionMemory::InstructionMemory(const ll* words, size_t count) {
+    imem = vector<ll>(max((size_t) IMEM_SIZE, count + IMEM_PADDING), 0);
+    copy(words, words + count, imem.begin());
+    this->count = count;
+}
+
+MemoryImage::MemoryImage(string file) {
+    unique_ptr<ImageFile> img;
+    unique_ptr<ElfFile> elf;
+    if(isImageFile(file))
+        img.reset(new ImageFile(file));
+    else if(isElfFile(file))
+        elf.reset(new ElfFile(file));
+    valid = (img == nullptr || img->valid) && (elf == nullptr || elf->valid);
+    size = MEMORY_SIZE;
+    if(img != nullptr)
+        size = max(size, (size_t) img->memoryWords);
+    if(elf != nullptr)
+        size = max(size, elf->memoryWords());
+    create(file, [&](ll* writable) {
+        if(elf != nullptr)
+            elf->fill(writable, size);
+        else if(img != nullptr) {
+            // the words have to end up in the memfd itself, so nothing is mapped
+            img->mapData(writable, size, false);
+        }
+        else {
+            string buffer;
+            if(readWholeFile(file, buffer))
+                parseMemory(buffer, writable, size);
+        }
+    });
+}
+
+MemoryImage::MemoryImage(const ll* initial, size_t count) {
+    size = max((size_t) MEMORY_SIZE, count);
+    create("buffer", [&](ll* writable) {
+        copy(initial, initial + count, writable);
+    });
+}
+
+void MemoryImage::create(const string& name, const function<void(ll*)>& fill) {
+    size_t bytes = size * sizeof(ll);
+    // the constructor throws on failure, so no destructor closes fd then
+    auto fail = [&](const string& what) {
+        if(fd >= 0)
+            close(fd);
+        fd = -1;
+        throw runtime_error("cannot " + what + " memory image for " + name);
+    };
+    fd = memfd_create("mips-memory", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0 || ftruncate(fd, bytes) != 0)
+        fail("create");
+    ll* writable = (ll*) mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(writable == MAP_FAILED)
+        fail("map");
+    try {
+        fill(writable);
+    }
+    catch(...) {
+        munmap(writable, bytes);
+        close(fd);
+        fd = -1;
+        throw;
+    }
+    munmap(writable, bytes);
+    // unsealed, the words of every Memory of the image could change under it
+    if(fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        cerr << name << ": cannot seal memory image" << endl;
+        valid = false;
+    }
+
+    void* p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED)
+        fail("map");
+    words = (const ll*) p;
+}
+
+MemoryImage::~MemoryImage() {
+    if(words != nullptr)
+        munmap((void*) words, size * sizeof(ll));
+    if(fd >= 0)
+        close(fd);
+}
+
+Memory::Memory(string file) {
+    if(isImageFile(file)) {
+        ImageFile image(file);
+        valid = image.valid;
+        allocate(max((size_t) MEMORY_SIZE, (size_t) image.memoryWords));
+        image.mapData(memory, size);
+        return;
+    }
+    if(isElfFile(file)) {
+        ElfFile elf(file);
+        valid = elf.valid;
+        allocate(max((size_t) MEMORY_SIZE, elf.memoryWords()));
+        elf.fill(memory, size);
+        return;
+    }
+
+    allocate(MEMORY_SIZE);
+    string buffer;
+    if(!readWholeFile(file, buffer)) {
+        cerr << file << ": cannot read memory" << endl;
+        valid = false;
+        return;
+    }
+    parseMemory(buffer, memory, size);
+}
+
+Memory::Memory(size_t words) {
+    allocate(words);
+}
+
+Memory::Memory(shared_ptr<const MemoryImage> image) : image(image) {
+    size = image->size;
+    mappedBytes = size * sizeof(ll);
+    // private mapping of the shared memfd: pages are copied on first store
+    void* p = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, image->fd, 0);
+    if(p == MAP_FAILED)
+        throw bad_alloc();
+    memory = (ll*) p;
+    trackPages();
+}
+
+bool Memory::reset() {
+    if(image == nullptr)
+        return false;
+    size_t pageBytes = sizeof(ll) << pageShift;
+    for(size_t page : dirtyPages) {
+        // discarding a private page of a file mapping reverts it to the file
+        madvise((char*) memory + page * pageBytes, pageBytes, MADV_DONTNEED);
+        dirty[page] = 0;
+    }
+    dirtyPages.clear();
+    return true;
+}
+
+void Memory::trackPages() {
+    size_t pageWords = sysconf(_SC_PAGESIZE) / sizeof(ll);
+    pageShift = 0;
+    while(((size_t) 1 << pageShift) < pageWords)
+        pageShift++;
+    dirty.assign((size >> pageShift) + 1, 0);
+    dirtyPages.clear();
+}
+
+void Memory::allocate(size_t words) {
+    size = words;
+    mappedBytes = size * sizeof(ll);
+    // anonymous mappings are zero-filled, which is the initial memory state;
+    // executables may ask for gigabytes of which they touch a few pages
+    void* p = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(p == MAP_FAILED)
+        throw bad_alloc();
+    memory = (ll*) p;
+    trackPages();
+}
+
+Memory::~Memory() {
+    munmap(memory, mappedBytes);
+}
@@ -0,0 +1,117 @@
+#ifndef MEMORY_HEADER
+#define MEMORY_HEADER
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#define ll long long
+using namespace std;
+
+#define IMEM_SIZE 4096
+// noops kept past the end of a program, which the pipelines fetch while
+// the last instructions drain
+#define IMEM_PADDING 8
+#define MEMORY_SIZE 100000  // change to 1e6 later
+
+class InstructionMemory {
+public: 
+    /*
+        Constructor reads instructions from file and writes them to the memory vector.
+        Instructions are in the form of longs which will be decoded using an Instruction
+        class. The file is either the decimal text format, a binary image, in which
+        case the text segments are loaded, or a MIPS executable (see elfload.h), in
+        which case imem grows to hold its executable segments.
+    */
+    InstructionMemory(string file);
+    // instructions assembled in-process, from address 0
+    InstructionMemory(const vector<ll>& words);
+    InstructionMemory(const ll* words, size_t count);
+    vector<ll> imem;
+    int count = 0;  // number of instructions read from the file
+    // for a program assembled from source: the file and the line of each word
+    string source;
+    vector<int> lines;
+    // false if the file could not be read, a text line is not a number or an
+    // image or executable was rejected, see stderr
+    bool valid = true;
+
+    // where and with which registers the program starts, other than 0 for
+    // executables
+    ll entry = 0;
+    ll stackPointer = 0, globalPointer = 0;
+};
+
+/*
+    Immutable initial memory shared between runs of the same input. The words
+    are kept in a memfd so that every Memory created from the image maps them
+    privately: runs share the pages until they store into them.
+*/
+class MemoryImage {
+public:
+    MemoryImage(string file);
+    // count words from address 0, the rest of the MEMORY_SIZE words zero
+    MemoryImage(const ll* initial, size_t count);
+    ~MemoryImage();
+    MemoryImage(const MemoryImage&) = delete;
+    MemoryImage& operator=(const MemoryImage&) = delete;
+
+    const ll* words = nullptr;
+    size_t size = 0;
+    int fd = -1;
+    bool valid = true;  // as for Memory, and false if the memfd could not be sealed
+
+private:
+    // creates the sealed memfd of size words, filled by fill; throws
+    // runtime_error, with the memfd closed, if it cannot be created or mapped
+    void create(const string& name, const function<void(ll*)>& fill);
+};
+
+class Memory {
+public:
+    /*
+        Reads the initial memory from a text file of "pos-val" lines, a
+        binary image or the segments of a MIPS executable. The words live in an anonymous mapping so that the
+        data segments of an image can be mapped over it copy-on-write.
+    */
+    Memory(string file);
+    // words zero words, for a loader to fill (see asyncload.h)
+    explicit Memory(size_t words);
+    // copy-on-write view of a shared image; can be reset to it
+    Memory(shared_ptr<const MemoryImage> image);
+    ~Memory();
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
+    // every store goes through here so the pages it touches are known
+    inline void store(size_t index, ll value) {
+        memory[index] = value;
+        size_t page = index >> pageShift;
+        if(!dirty[page]) {
+            dirty[page] = 1;
+            dirtyPages.push_back(page);
+        }
+    }
+
+    /*
+        Restores the initial contents by dropping the private copies of the
+        dirty pages, in O(dirty pages). Only possible for memories created
+        from a MemoryImage; returns false otherwise.
+    */
+    bool reset();
+
+    ll* memory = nullptr;
+    size_t size = 0;
+    bool valid = true;  // false if the file could not be read or was rejected; memory is then zero
+    int pageShift = 0;              // log2 of the words per host page
+    vector<unsigned char> dirty;    // per page, set by store()
+    vector<size_t> dirtyPages;      // pages in the order they were first stored to
+
+private:
+    void allocate(size_t words);
+    void trackPages();
+    shared_ptr<const MemoryImage> image;
+    size_t mappedBytes = 0;
+};
+
+#endif
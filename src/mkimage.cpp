@@ -0,0 +1,44 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "image.h"
+#include "memory.h"
+#define ll long long
+using namespace std;
+
+/*
+    Converts the text inputs of the simulators into a binary image:
+
+        mkimage <instructions> <memory> <output>
+
+    Either input may be given as "-" to leave that part out. The image can
+    then be passed to proc_simN in place of both text files.
+*/
+
+int main(int argc, char* argv[]) {
+    if(argc != 4) {
+        cerr << "usage: " << argv[0] << " <instructions|-> <memory|-> <output>" << endl;
+        return 1;
+    }
+    string instrFile = argv[1], memFile = argv[2];
+
+    vector<ll> text;
+    if(instrFile != "-") {
+        InstructionMemory IMEM(instrFile);
+        // the reason is on stderr already
+        if(!IMEM.valid)
+            return 1;
+        text.assign(IMEM.imem.begin(), IMEM.imem.begin() + IMEM.count);
+    }
+
+    bool written;
+    if(memFile != "-") {
+        Memory MEM(memFile);
+        if(!MEM.valid)
+            return 1;
+        written = writeImage(argv[3], text, MEM.memory, MEM.size);
+    }
+    else
+        written = writeImage(argv[3], text, nullptr, 0);
+    return written ? 0 : 1;
+}
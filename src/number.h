@@ -0,0 +1,42 @@
+#ifndef NUMBER_HEADER
+#define NUMBER_HEADER
+
+#include <charconv>
+#include <climits>
+#include <string>
+#define ll long long
+using namespace std;
+
+/*
+    The whole of text as a number, decimal or, with hex, also 0x followed
+    by hex digits, with an optional minus sign. Anything else, including
+    trailing characters and values out of range, is an error.
+*/
+inline bool number(const string& text, ll& out, bool hex = false) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    bool negative = p != end && *p == '-';
+    p += negative;
+    int base = 10;
+    if(hex && end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        base = 16;
+        p += 2;
+    }
+    unsigned long long magnitude = 0;
+    from_chars_result r = from_chars(p, end, magnitude, base);
+    if(r.ec != errc() || r.ptr != end || magnitude > (unsigned long long) LLONG_MAX)
+        return false;
+    out = negative ? -(ll) magnitude : (ll) magnitude;
+    return true;
+}
+
+// number() for a value of type int
+inline bool number(const string& text, int& out) {
+    ll n;
+    if(!number(text, n) || n < INT_MIN || n > INT_MAX)
+        return false;
+    out = n;
+    return true;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#include <cstdlib>
+#include <iostream>
+#include "number.h"
+#include "options.h"
+#define ll long long
+
+using namespace std;
+
+static void usage(const char* name) {
+    cerr << "usage: " << name << " <instructions> <memory> [options]" << endl;
+    cerr << "  --watch=BEGIN:END --count-accesses" << endl;
+    cerr << "  --dump=text|nonzero|touched|binary --dump-file=PATH" << endl;
+    cerr << "  --stats=PATH --stats-format=json|csv --stats-interval=N" << endl;
+    cerr << "  --trace=PATH --perf --profile=PATH --source=PATH --callgraph=PATH" << endl;
+    cerr << "  --max-cycles=N --seed=N --mshrs=N --decoupled --interval=N --warmup=N --threads=N" << endl;
+    cerr << "  --batch=LIST" << endl;
+    exit(1);
+}
+
+// value of "--name=value" if arg has that form
+static bool value(const string& arg, const string& name, string& out) {
+    if(arg.compare(0, name.size() + 1, name + "=") != 0)
+        return false;
+    out = arg.substr(name.size() + 1);
+    return true;
+}
+
+// v of arg as a number into out, or usage
+template<class T>
+static void parse(const char* name, const string& arg, const string& v, T& out) {
+    if(!number(v, out)) {
+        cerr << "not a number in range in " << arg << endl;
+        usage(name);
+    }
+}
+
+Options::Options(int argc, char* argv[]) {
+    if(argc < 3)
+        usage(argv[0]);
+    program = argv[1];
+    memory = argv[2];
+    for(int i = 3; i < argc; i++) {
+        string arg = argv[i], v;
+        if(value(arg, "--watch", v)) {
+            size_t colon = v.find(':');
+            ll begin, end;
+            if(colon == string::npos || !number(v.substr(0, colon), begin, true)
+                    || !number(v.substr(colon + 1), end, true)) {
+                cerr << "not BEGIN:END in " << arg << endl;
+                usage(argv[0]);
+            }
+            watchpoints.push_back({begin, end});
+        }
+        else if(arg == "--count-accesses")
+            countAccesses = true;
+        else if(value(arg, "--dump", v)) {
+            if(!parseDumpFormat(v, dump))
+                usage(argv[0]);
+        }
+        else if(value(arg, "--dump-file", v))
+            dumpFile = v;
+        else if(value(arg, "--stats", v))
+            statsFile = v;
+        else if(value(arg, "--stats-format", v)) {
+            if(v != "json" && v != "csv")
+                usage(argv[0]);
+            statsFormat = v;
+        }
+        else if(value(arg, "--stats-interval", v))
+            parse(argv[0], arg, v, statsInterval);
+        else if(value(arg, "--trace", v))
+            traceFile = v;
+        else if(arg == "--perf")
+            perf = true;
+        else if(value(arg, "--profile", v))
+            profileFile = v;
+        else if(value(arg, "--source", v))
+            sourceFile = v;
+        else if(value(arg, "--callgraph", v))
+            callGraphFile = v;
+        else if(value(arg, "--max-cycles", v))
+            parse(argv[0], arg, v, maxCycles);
+        else if(value(arg, "--seed", v))
+            parse(argv[0], arg, v, seed);
+        else if(value(arg, "--mshrs", v))
+            parse(argv[0], arg, v, mshrs);
+        else if(arg == "--decoupled")
+            decoupled = true;
+        else if(value(arg, "--interval", v))
+            parse(argv[0], arg, v, interval);
+        else if(value(arg, "--warmup", v))
+            parse(argv[0], arg, v, warmup);
+        else if(value(arg, "--threads", v))
+            parse(argv[0], arg, v, threads);
+        else if(value(arg, "--batch", v))
+            batchFile = v;
+        else {
+            cerr << "unknown option " << arg << endl;
+            usage(argv[0]);
+        }
+    }
+}
+
+bool Options::hooksEnabled() const {
+    return countAccesses || !watchpoints.empty();
+}
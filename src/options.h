@@ -0,0 +1,89 @@
+#ifndef OPTIONS_HEADER
+#define OPTIONS_HEADER
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "dump.h"
+#define ll long long
+using namespace std;
+
+/*
+    Command line of the simulators:
+
+        proc_simN <instructions> <memory> [options]
+
+    instructions is decimal words, a binary image or assembly source (.s or
+    .asm), which is assembled in memory.
+
+    --watch=BEGIN:END   report loads and stores to byte addresses [BEGIN, END)
+    --count-accesses    count memory loads and stores
+    --dump=FORMAT       final state as text (default), nonzero, touched or
+                        binary; see dump.h
+    --dump-file=PATH    write the final state to PATH instead of stdout
+    --stats=PATH        write the statistics registry to PATH at exit
+    --stats-format=F    json (default) or csv; see stats.h
+    --stats-interval=N  also write a snapshot every N cycles
+    --trace=PATH        write a Konata pipeline trace to PATH
+    --profile=PATH      write a listing with cycles, executions and stalls
+                        charged to each instruction to PATH
+    --source=PATH       assembly source to annotate in the profile listing,
+                        for programs not given as .s or .asm
+    --callgraph=PATH    write folded call stacks of the simulated program
+                        to PATH and per-function cycles to PATH.summary
+    --max-cycles=N      stop after N cycles even if the program has not
+                        finished
+    --seed=N            seed of the random load misses of proc_sim3
+                        (default: the time)
+    --mshrs=N           let up to N load misses of proc_sim3 be outstanding
+                        while independent instructions go on; 0 (default)
+                        for loads that freeze the pipeline
+    --decoupled         execute the program on one thread and replay the
+                        pipeline timing on another; see decoupled.h
+    --interval=N        simulate the run in intervals of N instructions on
+                        parallel threads, from checkpoints of a functional
+                        pass; see interval.h
+    --warmup=N          instructions simulated before each interval starts
+                        counting cycles (default 100)
+    --threads=N         threads for --interval (default: one per core)
+    --batch=LIST        also run the program on every memory file listed in
+                        LIST, one per line, in lockstep with <memory>; see
+                        batch.h. The final state of the i-th listed memory
+                        follows that of <memory> on stdout, or goes to
+                        PATH.i with --dump-file=PATH
+    --perf              report host time, simulation speed and host hardware
+                        counters to stderr
+
+    Diagnostics go to stderr so that stdout keeps the format checker.py reads.
+*/
+class Options {
+public:
+    Options(int argc, char* argv[]);
+    // defaults, for runs that do not come from a command line
+    Options() = default;
+
+    // whether the run needs MemoryHooks instead of NoHooks
+    bool hooksEnabled() const;
+
+    string program, memory;
+    vector<pair<ll, ll>> watchpoints;
+    bool countAccesses = false;
+    DumpFormat dump = DUMP_TEXT;
+    string dumpFile;
+    string statsFile, statsFormat = "json";
+    ll statsInterval = 0;
+    string traceFile;
+    bool perf = false;
+    string profileFile, sourceFile;
+    string callGraphFile;
+    ll maxCycles = 0;       // 0 for no limit
+    ll seed = -1;           // -1 to seed from the time
+    int mshrs = 0;          // 0 or less for blocking loads
+    bool decoupled = false;
+    ll interval = 0;        // 0 for one serial run
+    ll warmup = 100;
+    int threads = 0;        // 0 for one per core
+    string batchFile;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+#include "perf.h"
+#define ll long long
+
+using namespace std;
+
+#ifdef __linux__
+static int openCounter(uint64_t config, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+HostPerf::HostPerf(bool hardwareCounters) {
+#ifdef __linux__
+    if(!hardwareCounters)
+        return;
+    fds[0] = openCounter(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if(fds[0] < 0)
+        return;
+    fds[1] = openCounter(PERF_COUNT_HW_CACHE_MISSES, fds[0]);
+    fds[2] = openCounter(PERF_COUNT_HW_BRANCH_MISSES, fds[0]);
+    countersAvailable = fds[1] >= 0 && fds[2] >= 0;
+#endif
+}
+
+HostPerf::~HostPerf() {
+    for(int fd : fds) {
+        if(fd >= 0)
+            close(fd);
+    }
+}
+
+void HostPerf::begin(HostPhase phase) {
+#ifdef __linux__
+    if(phase == PHASE_SIMULATE && countersAvailable) {
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    started[phase] = chrono::steady_clock::now();
+}
+
+void HostPerf::end(HostPhase phase) {
+    chrono::duration<double> d = chrono::steady_clock::now() - started[phase];
+    seconds[phase] += d.count();
+#ifdef __linux__
+    if(phase == PHASE_SIMULATE && countersAvailable) {
+        ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t values[4];     // nr, then one value per counter
+        if(read(fds[0], values, sizeof(values)) == sizeof(values)) {
+            hostInstructions += values[1];
+            cacheMisses += values[2];
+            branchMisses += values[3];
+        }
+    }
+#endif
+}
+
+static double perKilo(ll events, ll instructions) {
+    return instructions ? events * 1000.0 / instructions : 0.0;
+}
+
+void HostPerf::registerStats(Stats& stats, const ll* cycles, const ll* instructions) {
+    stats.formula("host.load_seconds", "wall time reading the inputs",
+            [this]() { return seconds[PHASE_LOAD]; });
+    stats.formula("host.simulate_seconds", "wall time of the simulation loop",
+            [this]() { return seconds[PHASE_SIMULATE]; });
+    stats.formula("host.dump_seconds", "wall time writing the final state",
+            [this]() { return seconds[PHASE_DUMP]; });
+    stats.formula("host.cycles_per_second", "simulated cycles per second of simulation",
+            [this, cycles]() { return seconds[PHASE_SIMULATE] > 0 ? *cycles / seconds[PHASE_SIMULATE] : 0.0; });
+    stats.formula("host.instructions_per_second", "simulated instructions per second of simulation",
+            [this, instructions]() { return seconds[PHASE_SIMULATE] > 0 ? *instructions / seconds[PHASE_SIMULATE] : 0.0; });
+    if(!countersAvailable)
+        return;
+    stats.formula("host.instructions_pki", "host instructions per simulated kilo-instruction",
+            [this, instructions]() { return perKilo(hostInstructions, *instructions); });
+    stats.formula("host.cache_misses_pki", "host cache misses per simulated kilo-instruction",
+            [this, instructions]() { return perKilo(cacheMisses, *instructions); });
+    stats.formula("host.branch_misses_pki", "host branch misses per simulated kilo-instruction",
+            [this, instructions]() { return perKilo(branchMisses, *instructions); });
+}
+
+void HostPerf::report(ostream& out, ll cycles, ll instructions) {
+    double sim = seconds[PHASE_SIMULATE];
+    out << "Host time: load " << seconds[PHASE_LOAD] << "s, simulate " << sim
+        << "s, dump " << seconds[PHASE_DUMP] << "s" << endl;
+    if(sim > 0)
+        out << "Host speed: " << (ll) (cycles / sim) << " cycles/s, "
+            << (ll) (instructions / sim) << " instructions/s" << endl;
+    if(countersAvailable)
+        out << "Host counters per simulated kilo-instruction: "
+            << perKilo(hostInstructions, instructions) << " instructions, "
+            << perKilo(cacheMisses, instructions) << " cache misses, "
+            << perKilo(branchMisses, instructions) << " branch misses" << endl;
+    else
+        out << "Host counters: unavailable" << endl;
+}
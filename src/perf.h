@@ -0,0 +1,43 @@
+#ifndef PERF_HEADER
+#define PERF_HEADER
+
+#include <chrono>
+#include <iostream>
+#include "stats.h"
+#define ll long long
+using namespace std;
+
+/*
+    Efficiency of the simulator itself: wall time of the load, simulate and
+    dump phases, simulation speed, and optionally host hardware counters
+    (instructions, cache misses, branch misses) for the simulate phase via
+    perf_event_open. Where the counters cannot be opened (no kernel support,
+    perf_event_paranoid, containers) only the timings are reported.
+*/
+
+enum HostPhase {PHASE_LOAD, PHASE_SIMULATE, PHASE_DUMP, HOST_PHASES};
+
+class HostPerf {
+public:
+    HostPerf(bool hardwareCounters);
+    ~HostPerf();
+    HostPerf(const HostPerf&) = delete;
+    HostPerf& operator=(const HostPerf&) = delete;
+
+    void begin(HostPhase phase);
+    void end(HostPhase phase);
+
+    // adds host.* entries; cycles and instructions are the simulated counts
+    void registerStats(Stats& stats, const ll* cycles, const ll* instructions);
+    void report(ostream& out, ll cycles, ll instructions);
+
+    double seconds[HOST_PHASES] = {0, 0, 0};
+    bool countersAvailable = false;
+    ll hostInstructions = 0, cacheMisses = 0, branchMisses = 0;
+
+private:
+    int fds[3] = {-1, -1, -1};
+    chrono::steady_clock::time_point started[HOST_PHASES];
+};
+
+#endif
@@ -3,10 +3,22 @@
 #include <string>
 #include <vector>
 #include "instruction.h"
+#include "callgraph.h"
+#include "memory.h"
+#include "hooks.h"
+#include "options.h"
+#include "perf.h"
+#include "profile.h"
+#include "stats.h"
+#include "simulator.h"
+#include "trace.h"
 
 #define ll long long
 using namespace std;
 
+namespace {
+
+
 class IFID {
 public: 
     ll PC = 0;
@@ -70,354 +82,413 @@ public:
     }
     vector<ll> rf;
 };
- 
 
-
-class InstructionMemory {
-public: 
-    InstructionMemory(string file) {
-        /*
-            Constructor reads instructions from file and writes them to the memory vector.
-            Instructions are in the form of longs which will be decoded using an Instruction
-            class.
-        */
-        imem = vector<ll>(4096, 0);
-        ifstream myfile (file);
-        int i = 0;
-
-        if (myfile.is_open()) {
-            
-            string line;
-            while (getline(myfile, line)){
-                imem[i] = stoll(line);
-                i++;
-            }
-
-            myfile.close();
-        }
-    }
-
-    vector<ll> imem;
+// a new PC from EX for a taken branch, which replaces the one of fetch
+class Redirect {
+public:
+    bool taken = false;
+    ll PC = 0;
 };
 
-
-
-class Memory {
+// a register file write outside of write back: the return address of jal
+class RegisterWrite {
 public:
-    Memory(string file) {
-
-        memory = vector<ll>(100000, 0);
-        ifstream myfile (file);
-        
-        if (myfile.is_open()) {
-            
-            string line;
-            while (getline(myfile, line)){
-                size_t index = line.find("-");
-                size_t start = 0;
-                
-                ll pos = stoll(line.substr(start, index));
-                ll val = stoll(line.substr(index + 1, string::npos));
-                
-                memory[pos] = val;
-            }
-
-            myfile.close();
-        }
-    }
-
-    vector<ll> memory; 
+    bool valid = false;
+    int reg = 0;
+    ll value = 0;
 };
 
-
-
-void writeLogs(int numCycles, int numInstr, vector<ll> &rf, vector<ll> &memory) {
-
-    /*  
-        In the logs, we mention number of cycles required, total instruction
-        executed, contents of the register files and the contents of the
-        memory file. 
-    */
-
-    cout << "Cycles: " << numCycles << endl;
-    cout << "Instructions: " << numInstr << endl;
-    cout << endl << "Register file: " << endl;
-    for(int i = 0; i < 4; i++) {
-        for(int j = 0; j < 8; j++) 
-            cout << rf[8 * i + j] << " ";
-        cout<<endl;
-    }
-
-    cout << endl << "Memory: " << endl;
-    for(int i = 0; i < 20; i++) {
-        for(int j = 0; j < 5000; j++) 
-            cout << memory[5000 * i + j] << " ";
-        cout<<endl;
-    }
-    cout << endl;
-
-}
-
-int main(int argc, char* argv[]) {
-
-    RegisterFile RF;
-    InstructionMemory IMEM(argv[1]);
-    Memory MEM(argv[2]);
+/*
+    The program counter and the pipeline registers, as a cycle leaves them,
+    and what the cycle leaves for the clock edge besides: both are applied
+    by commit() when next becomes now.
+*/
+class PipelineState {
+public:
+    ll PC = 0;
     IFID ifid;
     IDEX idex;
     EXMEM exmem;
     MEMWB memwb;
+    Redirect redirect;
+    RegisterWrite rfWrite;
+};
 
-    ll PC = 0;
-    int clk = 0;
-
-    bool stop = false; // stop execution when instruction in all pipeline registers are noops.
-    ll jumpOffset = 0;
-    int jumpRegIndex = 0;
-    ll numCycles = 0, numStalls = 0, numInstr = 0;
-
-    bool hazard = false;    // flag to indicate whether a hazard is present b/w instructions
-    bool branchStall = false;   // flag to indicate a stall if a branch instruction is seen
-    bool jumpPosition = false;
-    bool jumpReg = false;
+/*
+    The pipeline state, simulated one clock cycle per call of cycle() so
+    that a run can be stopped and resumed at any cycle. It is instantiated
+    once with NoHooks and once with MemoryHooks, so runs without hooks pay
+    nothing for them.
+*/
+template<class Hooks>
+class ProcSim : public Core {
+public:
+    ProcSim(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+    ll run(ll cycles) override;
+    void finish() override;
+    bool halted() const override { return stop; }
+    const vector<ll>& registers() const override { return RF.rf; }
+    void restore(ll at, const vector<ll>& rf) override { now.PC = next.PC = at; RF.rf = rf; }
+    Latches latches() const override {
+        return latchState(now.PC, now.ifid, now.idex, now.exmem, now.memwb);
+    }
+    Counters counters() const override {
+        return {numCycles, numInstr, hazardStalls, branchStalls, jumpStalls, 0};
+    }
 
     /*
-        There are three types of situations that need to be handled:
-        1)  A data hazard. A data hazard can occur when the read register for
-            the IFID register and the write register for the IDEX or EXMEM 
-            register are the same.
-        2)  A jump instruction requires a gap of one instruction. A bubble
-            will be inserted after each jump(j, jr, jal)
-        3)  For a branch instruction, we wait till the instruction has reached
-            the end of the IDEX stage. After that, we update PC and then 
-            resumption of execution takes place. 
+        One clock cycle: the current MEMWB and EXMEM write the register file
+        and memory, every stage computes its latch in next from the latches
+        in now, and then commit() makes next now for all of them at once.
     */
+    inline void cycle();
+    inline void commit();
+    inline void writeBack();
+    inline void memoryStage();
+    inline void executeStage();
+    inline void decodeStage(bool hazard);
+    inline void fetchStage(bool branchStall, bool hazard);
+
+    const Options& options;
+    InstructionMemory& IMEM;
+    Memory& MEM;
+    HostPerf& perf;
+    Hooks hooks;
 
-    while(!stop) {
-        if(clk == 0) {
-
-            /*
-                When the clock is not asserted, all the writes are done. 
-                There are only two writes to be made that is, one in the
-                memory and one in the register file. 
-            */
+    RegisterFile RF;
+    // the latches the last cycle left and those the next one computes,
+    // equal between cycles
+    PipelineState now, next;
 
-            if(memwb.toWrite()) {
-                int position = memwb.writeRFAddress;
-                RF.rf[position] = memwb.writeData;
-            }
+    bool stop = false; // stop execution when instruction in all pipeline registers are noops.
+    ll numCycles = 0, numInstr = 0;
+    ll hazardStalls = 0, branchStalls = 0, jumpStalls = 0;
+
+    Stats stats;
+    Histogram* retireGap = nullptr;
+    ll lastRetire = 0;
+    PipelineTrace trace;
+    StallProfile profile;
+    CallGraph callGraph;
+};
 
-            if(exmem.toWrite()) {
-                int position = exmem.writeMemoryAddress ;
-                MEM.memory[position / 4] = exmem.writeData;
-            }
+template<class Hooks>
+ProcSim<Hooks>::ProcSim(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf)
+        : options(options), IMEM(IMEM), MEM(MEM), perf(perf),
+          stats(options.statsFile, options.statsFormat, options.statsInterval),
+          trace(options.traceFile), profile(options.profileFile, options.sourceFile, IMEM),
+          callGraph(options.callGraphFile) {
+    if constexpr (Hooks::enabled)
+        for(const pair<ll, ll>& w : options.watchpoints)
+            hooks.watch(w.first, w.second);
+    stats.counter("cycles", "simulated clock cycles", &numCycles);
+    stats.counter("instructions", "instructions that reached write back", &numInstr);
+    stats.counter("stalls.data_hazard", "bubbles inserted into IDEX for a data hazard (no forwarding)", &hazardStalls);
+    stats.counter("stalls.branch", "bubbles inserted into IFID while a branch resolves", &branchStalls);
+    stats.counter("stalls.jump", "bubbles inserted into IFID after j, jal and jr", &jumpStalls);
+    stats.formula("stalls.total", "all stall cycles", [this]() {
+        return (double) (hazardStalls + branchStalls + jumpStalls);
+    });
+    stats.formula("cpi", "cycles per instruction", [this]() {
+        return numInstr ? (double) numCycles / numInstr : 0.0;
+    });
+    retireGap = &stats.histogram("retire_gap",
+            "cycles between consecutive instructions reaching write back", 1, 8);
+    perf.registerStats(stats, &numCycles, &numInstr);
+
+    trace.watchStalls(&hazardStalls, &branchStalls, &jumpStalls, nullptr);
+    profile.watchStalls(&hazardStalls, &branchStalls, &jumpStalls, nullptr);
+}
 
-            clk = 1;
+/*
+    There are three types of situations that need to be handled:
+    1)  A data hazard. A data hazard can occur when the read register for
+        the IFID register and the write register for the IDEX or EXMEM 
+        register are the same.
+    2)  A jump instruction requires a gap of one instruction. A bubble
+        will be inserted after each jump(j, jr, jal)
+    3)  For a branch instruction, we wait till the instruction has reached
+        the end of the IDEX stage. After that, we update PC and then 
+        resumption of execution takes place. 
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::cycle() {
+    writeBack();
+    bool branchStall = isBranch(now.ifid.instruction) || isBranch(now.idex.instruction);
+    bool hazard = hazardExists(now.ifid.instruction, now.exmem.instruction)
+            || hazardExists(now.ifid.instruction, now.idex.instruction);
 
-        }
-        else {
-            /*
-                When the clock is asserted, the following things have to be done:
-                1) Updating all the intermediate register(IFID, IDEX...)
-                2) Updating the Program counter
+    /*
+        Every stage reads only now and the register file and memory as
+        write back left them, and writes only its part of next, so the
+        stages may run in any order. The taken branch and the return
+        address of jal take effect at the clock edge, in commit().
+    */
+    memoryStage();
+    executeStage();
+    decodeStage(hazard);
+    fetchStage(branchStall, hazard);
+    commit();
+
+    stop = isNoop(now.ifid.instruction) && isNoop(now.memwb.instruction)
+            && isNoop(now.idex.instruction) && isNoop(now.exmem.instruction);
+    numCycles++;
+    bool retired = !isNoop(now.memwb.instruction);
+    numInstr += retired;
+    if(retired) {
+        retireGap->sample(numCycles - lastRetire);
+        lastRetire = numCycles;
+    }
+    stats.tick(numCycles);
+    if(trace.enabled)
+        trace.cycle(numCycles, now.ifid.PC, now.ifid.instruction);
+    if(profile.enabled)
+        profile.cycle(now.ifid, now.idex, now.exmem, now.memwb, retired);
+    if(callGraph.enabled)
+        callGraph.cycle(now.memwb.instruction, retired);
+}
 
-                The idea of continuing the execution of statements after the
-                branch is problematic. That is because of the possibility of
-                a jump just after the branch. The right way of solving this 
-                problem is to stop execution until the branch condition
-                is truely known. 
+template<class Hooks>
+inline void ProcSim<Hooks>::commit() {
+    if(next.redirect.taken)
+        next.PC = next.redirect.PC;
+    if(next.rfWrite.valid)
+        RF.rf[next.rfWrite.reg] = next.rfWrite.value;
+    now = next;
+}
 
-                Algorithm: 
-                1)  If a branch instruction appears at the IFID register, 
-                    stop PC updation
-                2)  When the instruction reaches EXMEM stage, it is possible 
-                    to know whether a branch is to be taken or not. Normal 
-                    process can resume from the EXMEM stage.
+template<class Hooks>
+inline void ProcSim<Hooks>::writeBack() {
+    /*
+        All the writes of a cycle are done before the stages read, as
+        while the clock is not asserted. There are only two writes to be
+        made: one in the memory and one in the register file.
+    */
+    if(now.memwb.toWrite()) {
+        int position = now.memwb.writeRFAddress;
+        RF.rf[position] = now.memwb.writeData;
+    }
 
-                Two bubbles have to be inserted in the IFID register, then 
-                control will be resumed after one cycle. 
-            */
+    if(now.exmem.toWrite()) {
+        int position = now.exmem.writeMemoryAddress;
+        if constexpr (Hooks::enabled)
+            hooks.store(position, now.exmem.writeData, now.exmem.PC, numCycles);
+        MEM.store(position / 4, now.exmem.writeData);
+    }
+}
 
-            branchStall = (isBranch(ifid.instruction) || isBranch(idex.instruction));
+/*
+    The writeData in MEMWB depends on the previous instruction.
+    It can come from the Memory if the instruction is a load
+    and from the ALU if it is an R-type instruction.
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::memoryStage() {
+    const EXMEM& exmem = now.exmem;
+    MEMWB& memwb = next.memwb;
+
+    memwb.instruction = exmem.instruction;
+    if(isRType(exmem.instruction)) {
+        memwb.writeRFAddress = getRD(exmem.instruction);
+        memwb.writeData = exmem.aluResult;
+    }
+    else if(isLoad(exmem.instruction)) {
+        memwb.writeRFAddress = getRT(exmem.instruction);
+        memwb.writeData = MEM.memory[exmem.loadMemoryAddress / 4];
+        if constexpr (Hooks::enabled)
+            hooks.load(exmem.loadMemoryAddress, memwb.writeData, exmem.PC, numCycles);
+    }
+    else if(isLUI(exmem.instruction)) {
+        memwb.writeRFAddress = getRT(exmem.instruction);
+        memwb.writeData = toDecimal(toBinary(exmem.instruction), 16, 32) << 16;
+    }
+    memwb.PC = exmem.PC;
+}
 
-            ll PCTaken = exmem.branchPC;
+/*
+    In EXMEM, the things that have to be updated are the ALU results,
+    newly calculated PC, instruction, writeData for the memwb stage.
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::executeStage() {
+    const IDEX& idex = now.idex;
+    EXMEM& exmem = next.exmem;
+
+    exmem.instruction = idex.instruction;
+    exmem.PC = idex.PC;
+    next.redirect.taken = false;
+
+    if(isRType(idex.instruction)) {
+        Operation op = getOperation(idex.instruction);
+        int offset = toDecimal(toBinary(idex.instruction), 21, 26);
+        if(op == ADD)
+            exmem.aluResult = idex.r1 + idex.r2;
+        else if(op == SUB)
+            exmem.aluResult = idex.r1 - idex.r2;
+        else if(op == AND)
+            exmem.aluResult = idex.r1 & idex.r2;
+        else if(op == OR)
+            exmem.aluResult = idex.r1 | idex.r2;
+        else if(op == SLT)
+            exmem.aluResult = idex.r1 < idex.r2 ? 1 : 0;
+        else if(op == SLL)
+            exmem.aluResult = idex.r2 << offset;
+        else if(op == SRL)
+            exmem.aluResult = idex.r2 >> offset;
+    }
+    else if(isLoad(idex.instruction)) {
+        exmem.loadMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
+    }
+    else if(isStore(idex.instruction)) {
+        exmem.writeMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
+        exmem.writeData = idex.r2;
+    }
+    else if(isBranch(idex.instruction)) {
+        if(isBEQ(idex.instruction) && idex.r1 == idex.r2)
+            exmem.branch = true;
+        else if(isBNE(idex.instruction) && idex.r1 != idex.r2)
+            exmem.branch = true;
+        else
+            exmem.branch = false;
 
-            hazard = hazardExists(ifid.instruction, exmem.instruction) || 
-                    hazardExists(ifid.instruction, idex.instruction);
+        exmem.branchPC = idex.PC + 4 + getBranchOffset(idex.instruction) * 4;
 
-            jumpOffset = 4 * getJumpOffset(ifid.instruction);
-            jumpRegIndex = toDecimal(toBinary(ifid.instruction), 6, 11);
+        /*
+            Note that the branch is executed in this cycle. It was in IFID
+            two cycles ago, and fetch has stalled since, so its target
+            replaces the PC at the clock edge.
+        */
+        next.redirect.taken = exmem.branch;
+        next.redirect.PC = exmem.branchPC;
+    }
+}
 
-            // Updating MEMWB
+/*
+    In IDEX, only PC, instruction and the values from the register
+    file are to be read.
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::decodeStage(bool hazard) {
+    const IFID& ifid = now.ifid;
+    IDEX& idex = next.idex;
+
+    if(!hazard) {
+        idex.instruction = ifid.instruction;
+        idex.PC = ifid.PC;
+        idex.r1 = RF.rf[getRS(ifid.instruction)];
+        idex.r2 = RF.rf[getRT(ifid.instruction)];
+    }
+    else {
+        //insert bubble
+        hazardStalls++;
+        idex.instruction = 0;
+        idex.PC = 0;
+        idex.r1 = 0;
+        idex.r2 = 0;
+    }
+}
 
-            memwb.instruction = exmem.instruction;
-            if(isRType(exmem.instruction)) {
-                memwb.writeRFAddress = getRD(exmem.instruction);
-                memwb.writeData = exmem.aluResult;
-            }
-            else if(isLoad(exmem.instruction)) {
-                memwb.writeRFAddress = getRT(exmem.instruction);
-                memwb.writeData = MEM.memory[exmem.loadMemoryAddress / 4];
-            }
-            else if(isLUI(exmem.instruction)) {
-                memwb.writeRFAddress = getRT(exmem.instruction);
-                memwb.writeData = toDecimal(toBinary(exmem.instruction), 16, 32) << 16;
-            }
-            memwb.PC = exmem.PC;
-
-            /*
-                The writeData in MEMWB depends on the previous instruction.
-                It can come from the Memory if the instruction is a load
-                and from the ALU if it is an R-type instruction. 
-
-                Also, we must copy the instruction from EXMEM register.
-            */
-
-            // Updating EXMEM
-
-            exmem.instruction = idex.instruction;
-            exmem.PC = idex.PC;
-
-            if(isRType(idex.instruction)) {
-                Operation op = getOperation(idex.instruction);
-                int offset = toDecimal(toBinary(idex.instruction), 21, 26);
-                if(op == ADD) 
-                    exmem.aluResult = idex.r1 + idex.r2;
-                else if(op == SUB)
-                    exmem.aluResult = idex.r1 - idex.r2;
-                else if(op == AND)
-                    exmem.aluResult = idex.r1 & idex.r2;
-                else if(op == OR)
-                    exmem.aluResult = idex.r1 | idex.r2;
-                else if(op == SLT)
-                    exmem.aluResult = idex.r1 < idex.r2 ? 1 : 0;
-                else if(op == SLL)
-                    exmem.aluResult = idex.r2 << offset;
-                else if(op == SRL)
-                    exmem.aluResult = idex.r2 >> offset;
+/*
+    The idea of continuing the execution of statements after the
+    branch is problematic. That is because of the possibility of
+    a jump just after the branch. The right way of solving this
+    problem is to stop execution until the branch condition
+    is truely known.
+
+    Algorithm:
+    1)  If a branch instruction appears at the IFID register,
+        stop PC updation
+    2)  When the instruction reaches EXMEM stage, it is possible
+        to know whether a branch is to be taken or not. Normal
+        process can resume from the EXMEM stage.
+
+    Two bubbles have to be inserted in the IFID register, then
+    control will be resumed after one cycle.
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::fetchStage(bool branchStall, bool hazard) {
+    const IFID& ifid = now.ifid;
+    ll PC = now.PC;
+    next.rfWrite.valid = false;
+    bool jumpPosition = isJump(ifid.instruction) || isJAL(ifid.instruction);
+    bool jumpReg = isJR(ifid.instruction);
+
+    if(!branchStall) {
+        if(!hazard) {
+            if(isJump(ifid.instruction) || isJR(ifid.instruction)) {
+                next.ifid.PC = 0;
+                next.ifid.instruction = 0;
             }
-            else if(isLoad(idex.instruction)) {
-                exmem.loadMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
+            else if(isJAL(ifid.instruction)) {
+                next.ifid.PC = 0;
+                next.ifid.instruction = 0;
+                // the return address, written when the cycle commits
+                next.rfWrite = {true, 31, PC};
             }
-            else if(isStore(idex.instruction)) {
-                exmem.writeMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
-                exmem.writeData = idex.r2;
-            }
-            else if(isBranch(idex.instruction)) {
-
-                if(isBEQ(idex.instruction) && idex.r1 == idex.r2) 
-                    exmem.branch = true;
-                else if(isBNE(idex.instruction) && idex.r1 != idex.r2) 
-                    exmem.branch = true;
-                else
-                    exmem.branch = false;
-                
-                exmem.branchPC = idex.PC + 4 + getBranchOffset(idex.instruction) * 4;
-
+            else {
+                next.ifid.PC = PC;
+                next.ifid.instruction = IMEM.imem[PC / 4];
             }
-            
-            /*
-                In EXMEM, the things that have to be updated are the ALU results,
-                newly calculated PC, instruction, writeData for the memwb stage, 
-            */
-
-
-            // Updating IDEX
+        }
+        // else remains the same as before.
+    }
+    else {
+        if(!hazard) {
+            branchStalls++;
+            next.ifid.PC = 0;
+            next.ifid.instruction = 0;
+        }
+    }
 
-            if(!hazard) {
-                idex.instruction = ifid.instruction;
-                idex.PC = ifid.PC;
-                idex.r1 = RF.rf[getRS(ifid.instruction)];
-                idex.r2 = RF.rf[getRT(ifid.instruction)];    
+    // Updating the PC; a taken branch is applied by commit()
+    if(!branchStall) {
+        if(!hazard) {
+            if(jumpPosition) {
+                jumpStalls++;
+                next.PC = 4 * getJumpOffset(ifid.instruction);
             }
-            else {
-                //insert bubble 
-                
-                idex.instruction = 0;
-                idex.PC = 0;
-                idex.r1 = 0;
-                idex.r2 = 0;
-            }
-            // else if hazard2, contents of the register remain same
-
-            /*
-                In IDEX, only PC, instruction and the values from the register
-                file are to be read.
-            */
-
-            // Updating IFID
-            jumpPosition = isJump(ifid.instruction) || isJAL(ifid.instruction);
-            jumpReg = isJR(ifid.instruction);
-
-            if(!branchStall) {
-                if(!hazard) {
-                    if(isJump(ifid.instruction)) {
-                        ifid.PC = 0;
-                        ifid.instruction = 0;
-                    }
-                    else if(isJAL(ifid.instruction)) {
-                        ifid.PC = 0;
-                        ifid.instruction = 0;
-                        RF.rf[31] = PC;
-                    }
-                    else if(isJR(ifid.instruction)) {
-                        vector<int> bin = toBinary(ifid.instruction);
-                        ifid.PC = 0;
-                        ifid.instruction = 0;
-                    }
-                    else {
-                        ifid.PC = PC;
-                        ifid.instruction = IMEM.imem[PC / 4];
-                    }
-                }
-                // else remains the same as before.
+            else if(jumpReg) {
+                jumpStalls++;
+                next.PC = RF.rf[getRS(ifid.instruction)];
             }
             else {
-                if(!hazard) {
-                    ifid.PC = 0;
-                    ifid.instruction = 0;
-                }
+                next.PC = PC + 4;
             }
+        }
+        // else PC remains the same.
+    }
 
+    /*
+        It is important to remember that the offset of branch
+        is added to PC + 4 not directly to PC.
+    */
+}
 
-            // Updating the PC
-            if(branchStall && isBranch(exmem.instruction)) {
-                /* 
-                    Note that exmem.instruction has been executed in this cycle. 
-                    It is actually the value of IFID in the last cycle. 
-                */    
-                if(exmem.branch)
-                    PC = exmem.branchPC;
-                branchStall = false;
-            }
-            else if(!branchStall){
-                if(!hazard) {
-                    if(jumpPosition) {
-                        numStalls++;
-                        PC = jumpOffset;
-                    }
-                    else if(jumpReg) {
-                        numStalls++;
-                        PC = RF.rf[jumpRegIndex];
-                    }
-                    else {
-                        PC = PC + 4;    
-                    }
-                }
-                // else PC remains the same.
-            }
+template<class Hooks>
+ll ProcSim<Hooks>::run(ll cycles) {
+    ll start = numCycles;
+    perf.begin(PHASE_SIMULATE);
+    while(!stop && (cycles == 0 || numCycles - start < cycles)
+            && (options.maxCycles == 0 || numCycles < options.maxCycles))
+        cycle();
+    perf.end(PHASE_SIMULATE);
+    return numCycles - start;
+}
 
-            /*
-                It is important to remember that the offset of branch
-                is added to PC + 4 not directly to PC.
-            */ 
+template<class Hooks>
+void ProcSim<Hooks>::finish() {
+    stats.finish(numCycles);
+    trace.finish(numCycles);
+    profile.finish(IMEM.imem);
+    callGraph.finish();
+    if constexpr (Hooks::enabled)
+        hooks.report(cerr);
+}
 
-            stop = isNoop(ifid.instruction) && isNoop(memwb.instruction) 
-                    && isNoop(idex.instruction) && isNoop(exmem.instruction);
-            clk = 0;
-            numCycles++;
-            numInstr += !(isNoop(memwb.instruction));
-        }
-    }
-    writeLogs(numCycles, numInstr, RF.rf, MEM.memory);
-}
\ No newline at end of file
+}
+
+unique_ptr<Core> newProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    if(options.hooksEnabled())
+        return unique_ptr<Core>(new ProcSim<MemoryHooks>(options, IMEM, MEM, perf));
+    return unique_ptr<Core>(new ProcSim<NoHooks>(options, IMEM, MEM, perf));
+}
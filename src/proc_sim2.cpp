@@ -4,9 +4,21 @@
 #include <vector>
 #include <algorithm>
 #include "instruction.h"
+#include "callgraph.h"
+#include "memory.h"
+#include "hooks.h"
+#include "options.h"
+#include "perf.h"
+#include "profile.h"
+#include "stats.h"
+#include "simulator.h"
+#include "trace.h"
 #define ll long long
 using namespace std;
 
+namespace {
+
+
 class IFID {
 public: 
     ll PC = 0;
@@ -67,372 +79,489 @@ public:
     }
     vector<ll> rf;
 };
- 
-class InstructionMemory {
-public: 
-    /*
-        Constructor reads instructions from file and writes them to the memory vector.
-        Instructions are in the form of longs which will be decoded using an Instruction
-        class.
-    */
-    InstructionMemory(string file) {
-        imem = vector<ll>(4096, 0);
-        ifstream myfile (file);
-        int i = 0;
-        if (myfile.is_open()) {
-            string line;
-            while (getline(myfile, line)){
-                imem[i] = stoll(line);
-                i++;
-            }
-            myfile.close();
-        }
-    }
-    vector<ll> imem;
-};
 
-class Memory {
+// a new PC from EX for a taken branch, which replaces the one of fetch
+class Redirect {
 public:
-    Memory(string file) {
-        memory = vector<ll>(100000, 0); // change to 1e6 later
-        ifstream myfile (file);
-        if (myfile.is_open()) {
-            string line;
-            while (getline(myfile, line)){
-                size_t index = line.find("-");
-                size_t start = 0;
-                ll pos = stoll(line.substr(start, index));
-                ll val = stoll(line.substr(index + 1, string::npos));
-                memory[pos] = val;
-            }
-            myfile.close();
-        }
-    }
-
-    vector<ll> memory; 
+    bool taken = false;
+    ll PC = 0;
 };
 
-void writeLogs(int numCycles, int numInstr, vector<ll> &rf, vector<ll> &memory) {
-    cout << "Cycles: " << numCycles << endl;
-    cout << "Instructions: " << numInstr << endl;
-    cout << endl << "Register file: " << endl;
-    for(int i = 0; i < 4; i++) {
-        for(int j = 0; j < 8; j++) 
-            cout << rf[8 * i + j] << " ";
-        cout<<endl;
-    }
-
-    cout << endl << "Memory: " << endl;
-    for(int i = 0; i < 20; i++) {
-        for(int j = 0; j < 5000; j++) 
-            cout << memory[5000 * i + j] << " ";
-        cout<<endl;
-    }
-    cout << endl;
-}
+// a register file write outside of write back: the return address of jal
+class RegisterWrite {
+public:
+    bool valid = false;
+    int reg = 0;
+    ll value = 0;
+};
 
-int main(int argc, char* argv[]) {
-    RegisterFile RF;
-    InstructionMemory IMEM(argv[1]);
-    Memory MEM(argv[2]);
+/*
+    The program counter and the pipeline registers, as a cycle leaves them,
+    and what the cycle leaves for the clock edge besides: both are applied
+    by commit() when next becomes now.
+*/
+class PipelineState {
+public:
+    ll PC = 0;
     IFID ifid;
     IDEX idex;
     EXMEM exmem;
     MEMWB memwb;
+    Redirect redirect;
+    RegisterWrite rfWrite;
+};
 
-    ll PC = 0;
-    int clk = 0;
+/*
+    The pipeline state, simulated one clock cycle per call of cycle() so
+    that a run can be stopped and resumed at any cycle. It is instantiated
+    once with NoHooks and once with MemoryHooks, so runs without hooks pay
+    nothing for them.
+*/
+template<class Hooks>
+class ProcSim : public Core {
+public:
+    ProcSim(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+    ll run(ll cycles) override;
+    void finish() override;
+    bool halted() const override { return stop; }
+    const vector<ll>& registers() const override { return RF.rf; }
+    void restore(ll at, const vector<ll>& rf) override { now.PC = next.PC = at; RF.rf = rf; }
+    Latches latches() const override {
+        return latchState(now.PC, now.ifid, now.idex, now.exmem, now.memwb);
+    }
+    Counters counters() const override {
+        return {numCycles, numInstr, hazardStalls, branchStalls, jumpStalls, 0};
+    }
+
+    /*
+        One clock cycle: the current MEMWB and EXMEM write the register file
+        and memory, every stage computes its latch in next from the latches
+        in now, and then commit() makes next now for all of them at once.
+    */
+    inline void cycle();
+    inline void commit();
+    inline void writeBack();
+    inline void memoryStage();
+    inline void executeStage();
+    inline void decodeStage(bool hazard);
+    inline void fetchStage(bool branchStall, bool hazard);
+    inline ll executeResult() const;
+    inline ll memoryResult() const;
+    static inline ll upperImmediate(ll instruction);
+    inline ll operand(int reg, ll reader) const;
+
+    const Options& options;
+    InstructionMemory& IMEM;
+    Memory& MEM;
+    HostPerf& perf;
+    Hooks hooks;
+
+    RegisterFile RF;
+    // the latches the last cycle left and those the next one computes,
+    // equal between cycles
+    PipelineState now, next;
     bool stop = false; // stop execution when instruction in IFID and MEMWB are noops.
-    ll jumpOffset = 0;
-    int jumpRegIndex = 0;
-    ll numCycles = 0, numStalls = 0, numInstr = 0;
+    ll numCycles = 0, numInstr = 0;
+    ll hazardStalls = 0, branchStalls = 0, jumpStalls = 0;
+
 
-    bool hazard = false;
-    bool branchStall = false;
-    bool jumpPosition = false;
-    bool jumpReg = false;
+    Stats stats;
+    Histogram* retireGap = nullptr;
+    ll lastRetire = 0;
+    PipelineTrace trace;
+    StallProfile profile;
+    CallGraph callGraph;
+};
+
+template<class Hooks>
+ProcSim<Hooks>::ProcSim(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf)
+        : options(options), IMEM(IMEM), MEM(MEM), perf(perf),
+          stats(options.statsFile, options.statsFormat, options.statsInterval),
+          trace(options.traceFile), profile(options.profileFile, options.sourceFile, IMEM),
+          callGraph(options.callGraphFile) {
+    if constexpr (Hooks::enabled)
+        for(const pair<ll, ll>& w : options.watchpoints)
+            hooks.watch(w.first, w.second);
+    stats.counter("cycles", "simulated clock cycles", &numCycles);
+    stats.counter("instructions", "instructions that reached write back", &numInstr);
+    stats.counter("stalls.load_use", "bubbles inserted into IDEX for a load-use hazard", &hazardStalls);
+    stats.counter("stalls.branch", "bubbles inserted into IFID while a branch resolves", &branchStalls);
+    stats.counter("stalls.jump", "bubbles inserted into IFID after j, jal and jr", &jumpStalls);
+    stats.formula("stalls.total", "all stall cycles", [this]() {
+        return (double) (hazardStalls + branchStalls + jumpStalls);
+    });
+    stats.formula("cpi", "cycles per instruction", [this]() {
+        return numInstr ? (double) numCycles / numInstr : 0.0;
+    });
+    retireGap = &stats.histogram("retire_gap",
+            "cycles between consecutive instructions reaching write back", 1, 8);
+    perf.registerStats(stats, &numCycles, &numInstr);
+
+    trace.watchStalls(&hazardStalls, &branchStalls, &jumpStalls, nullptr);
+    profile.watchStalls(&hazardStalls, &branchStalls, &jumpStalls, nullptr);
+}
+
+/*
+    There are three types of situations that need to be handled:
+    1)  A data hazard. A data hazard can occur when the read register for
+        the IFID register and the write register for the IDEX or EXMEM 
+        register are the same.
+    2)  A jump instruction requires a gap of one instruction. A bubble
+        will be inserted after each jump(j, jr, jal)
+    3)  For a branch instruction, we wait till the instruction has reached
+        the end of the IDEX stage. After that, we update PC and then 
+        resumption of execution takes place. 
+
+-------------------------------------------------------------------------------
+
+
+    While dealing with forwarding, there are two types of forwarding.
+    Let the instructions be I1, I2, I3 where I3 is fed first into
+    the pipeline. 
+    1) I3 is an R-type instruction:
+        a)  If there is a conflict with I2, then we can forward from the EXMEM
+            register without any stalls
+        b)  If there is a conflict with I1, then we can forward from the MEMWB
+            register without any stalls
+        c)  If there is a conflict in both I1 and I2 we can forward in both
+            the cases without any stalls necessary
+
+    2) I3 is a load instruction: 
+        a)  If I2 is conflicting with I3, then we will have to stall for one
+            clock cycle and perform forwarding in the MEMWB stage. 
+        b)  If I1 is conflicting with I3, then we do not need to stall and we
+            can forward in the MEMWB stage. 
+        c)  Note that both the conflicts can not occur simultaneously. 
+
+
+    How we deal with the process of forwarding. 
+    Check for conflicts before updation of signals to their new values in the 
+    EXMEM and MEMWB stages. 
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::cycle() {
+    writeBack();
+    bool branchStall = isBranch(now.ifid.instruction) || isBranch(now.idex.instruction);
+    bool hazard = (isLoad(now.idex.instruction) || isLUI(now.idex.instruction))
+            && hazardExists(now.ifid.instruction, now.idex.instruction);
 
     /*
-        There are three types of situations that need to be handled:
-        1)  A data hazard. A data hazard can occur when the read register for
-            the IFID register and the write register for the IDEX or EXMEM 
-            register are the same.
-        2)  A jump instruction requires a gap of one instruction. A bubble
-            will be inserted after each jump(j, jr, jal)
-        3)  For a branch instruction, we wait till the instruction has reached
-            the end of the IDEX stage. After that, we update PC and then 
-            resumption of execution takes place. 
-
-    -------------------------------------------------------------------------------
-
-
-        While dealing with forwarding, there are two types of forwarding.
-        Let the instructions be I1, I2, I3 where I3 is fed first into
-        the pipeline. 
-        1) I3 is an R-type instruction:
-            a)  If there is a conflict with I2, then we can forward from the EXMEM
-                register without any stalls
-            b)  If there is a conflict with I1, then we can forward from the MEMWB
-                register without any stalls
-            c)  If there is a conflict in both I1 and I2 we can forward in both
-                the cases without any stalls necessary
-
-        2) I3 is a load instruction: 
-            a)  If I2 is conflicting with I3, then we will have to stall for one
-                clock cycle and perform forwarding in the MEMWB stage. 
-            b)  If I1 is conflicting with I3, then we do not need to stall and we
-                can forward in the MEMWB stage. 
-            c)  Note that both the conflicts can not occur simultaneously. 
-
-
-        How we deal with the process of forwarding. 
-        Check for conflicts before updation of signals to their new values in the 
-        EXMEM and MEMWB stages. 
+        Every stage reads only now and the register file and memory as
+        write back left them, and writes only its part of next, so the
+        stages may run in any order. The bypasses into IDEX compute what EX
+        and MEM latch from now as well (see operand()), and the taken
+        branch and the return address of jal take effect at the clock
+        edge, in commit().
     */
+    memoryStage();
+    executeStage();
+    decodeStage(hazard);
+    fetchStage(branchStall, hazard);
+    commit();
+
+    stop = isNoop(now.ifid.instruction) && isNoop(now.memwb.instruction)
+            && isNoop(now.idex.instruction) && isNoop(now.exmem.instruction);
+    numCycles++;
+    bool retired = !isNoop(now.memwb.instruction);
+    numInstr += retired;
+    if(retired) {
+        retireGap->sample(numCycles - lastRetire);
+        lastRetire = numCycles;
+    }
+    stats.tick(numCycles);
+    if(trace.enabled)
+        trace.cycle(numCycles, now.ifid.PC, now.ifid.instruction);
+    if(profile.enabled)
+        profile.cycle(now.ifid, now.idex, now.exmem, now.memwb, retired);
+    if(callGraph.enabled)
+        callGraph.cycle(now.memwb.instruction, retired);
+}
 
-    while(!stop) {
-        if(clk == 0) {
-            /*
-                When the clock is not asserted, all the writes are done. 
-                There are only two writes to be made that is in the
-                memory and the register file. 
-            */
-
-            if(memwb.toWrite()) {
-                int position = memwb.writeRFAddress;
-                RF.rf[position] = memwb.writeData;
-            }
+template<class Hooks>
+inline void ProcSim<Hooks>::commit() {
+    if(next.redirect.taken)
+        next.PC = next.redirect.PC;
+    if(next.rfWrite.valid)
+        RF.rf[next.rfWrite.reg] = next.rfWrite.value;
+    now = next;
+}
 
-            if(exmem.toWrite()) {
-                int position = exmem.writeMemoryAddress ;
-                MEM.memory[position / 4] = exmem.writeData;
-            }
-            clk = 1;
-        }
-        else {
-            /*
-                When the clock is asserted, the following things have to be done:
-                1) Updating all the intermediate register(IFID, IDEX...)
-                2) Updating the Program counter
+template<class Hooks>
+inline void ProcSim<Hooks>::writeBack() {
+    /*
+        All the writes of a cycle are done before the stages read, as
+        while the clock is not asserted. There are only two writes to be
+        made: one in the memory and one in the register file.
+    */
+    if(now.memwb.toWrite()) {
+        int position = now.memwb.writeRFAddress;
+        RF.rf[position] = now.memwb.writeData;
+    }
 
-                The idea of continuing the execution of statements after the
-                branch is problematic. That is because of the possibility of
-                a jump just after the branch. The right way of solving this 
-                problem is to stop execution until the branch condition
-                is truely known. 
+    if(now.exmem.toWrite()) {
+        int position = now.exmem.writeMemoryAddress;
+        if constexpr (Hooks::enabled)
+            hooks.store(position, now.exmem.writeData, now.exmem.PC, numCycles);
+        MEM.store(position / 4, now.exmem.writeData);
+    }
+}
 
-                Algorithm: 
-                1)  If a branch instruction appears at the IFID register, 
-                    stop PC updation
-                2)  When the instruction reaches EXMEM stage, it is possible 
-                    to know whether a branch is to be taken or not. Normal 
-                    process can resume from the EXMEM stage.
+/*
+    The writeData in MEMWB depends on the previous instruction.
+    It can come from the Memory if the instruction is a load
+    and from the ALU if it is an R-type instruction.
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::memoryStage() {
+    const EXMEM& exmem = now.exmem;
+    MEMWB& memwb = next.memwb;
+
+    memwb.instruction = exmem.instruction;
+    if(isRType(exmem.instruction)) {
+        memwb.writeRFAddress = getRD(exmem.instruction);
+        memwb.writeData = exmem.aluResult;
+    }
+    else if(isLoad(exmem.instruction)) {
+        memwb.writeRFAddress = getRT(exmem.instruction);
+        memwb.writeData = MEM.memory[exmem.loadMemoryAddress / 4];
+        if constexpr (Hooks::enabled)
+            hooks.load(exmem.loadMemoryAddress, memwb.writeData, exmem.PC, numCycles);
+    }
+    else if(isLUI(exmem.instruction)) {
+        memwb.writeRFAddress = getRT(exmem.instruction);
+        memwb.writeData = upperImmediate(exmem.instruction);
+    }
+    memwb.PC = exmem.PC;
+}
 
-                Two bubbles have to be inserted in the IFID register, then 
-                control will be resumed after one cycle. 
-            */
+/*
+    In EXMEM, the things that have to be updated are the ALU results,
+    newly calculated PC, instruction, writeData for the memwb stage.
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::executeStage() {
+    const IDEX& idex = now.idex;
+    EXMEM& exmem = next.exmem;
+
+    exmem.instruction = idex.instruction;
+    exmem.PC = idex.PC;
+    next.redirect.taken = false;
+
+    if(isRType(idex.instruction)) {
+        exmem.aluResult = executeResult();
+    }
+    else if(isLoad(idex.instruction)) {
+        exmem.loadMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
+    }
+    else if(isStore(idex.instruction)) {
+        exmem.writeMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
+        exmem.writeData = idex.r2;
+    }
+    else if(isBranch(idex.instruction)) {
+        if(isBEQ(idex.instruction) && idex.r1 == idex.r2)
+            exmem.branch = true;
+        else if(isBNE(idex.instruction) && idex.r1 != idex.r2)
+            exmem.branch = true;
+        else
+            exmem.branch = false;
+
+        exmem.branchPC = idex.PC + 4 + getBranchOffset(idex.instruction) * 4;
+
+        /*
+            Note that the branch is executed in this cycle. It was in IFID
+            two cycles ago, and fetch has stalled since, so its target
+            replaces the PC at the clock edge.
+        */
+        next.redirect.taken = exmem.branch;
+        next.redirect.PC = exmem.branchPC;
+    }
+}
 
-            branchStall = (isBranch(ifid.instruction) || isBranch(idex.instruction));
+/*
+    What EX latches in aluResult for the R-type instruction in IDEX and MEM
+    in writeData for the one in EXMEM that writes a register, in this
+    cycle and from now alone: the bypasses into IDEX compute them again
+    instead of reading them from next, so decode does not depend on EX and
+    MEM having run before it.
+*/
+template<class Hooks>
+inline ll ProcSim<Hooks>::executeResult() const {
+    const IDEX& idex = now.idex;
+    Operation op = getOperation(idex.instruction);
+    if(op == ADD)
+        return idex.r1 + idex.r2;
+    else if(op == SUB)
+        return idex.r1 - idex.r2;
+    else if(op == AND)
+        return idex.r1 & idex.r2;
+    else if(op == OR)
+        return idex.r1 | idex.r2;
+    else if(op == SLT)
+        return idex.r1 < idex.r2 ? 1 : 0;
+    // only the shifts have an offset, and decoding it allocates
+    else if(op == SLL)
+        return idex.r2 << toDecimal(toBinary(idex.instruction), 21, 26);
+    else if(op == SRL)
+        return idex.r2 >> toDecimal(toBinary(idex.instruction), 21, 26);
+    return now.exmem.aluResult;
+}
 
-            ll PCTaken = exmem.branchPC;
+template<class Hooks>
+inline ll ProcSim<Hooks>::memoryResult() const {
+    const EXMEM& exmem = now.exmem;
+    if(isRType(exmem.instruction))
+        return exmem.aluResult;
+    else if(isLoad(exmem.instruction))
+        return MEM.memory[exmem.loadMemoryAddress / 4];
+    return upperImmediate(exmem.instruction);
+}
 
-            hazard = (isLoad(idex.instruction) || isLUI(idex.instruction)) && hazardExists(ifid.instruction, idex.instruction);
+template<class Hooks>
+inline ll ProcSim<Hooks>::upperImmediate(ll instruction) {
+    return toDecimal(toBinary(instruction), 16, 32) << 16;
+}
 
-            jumpOffset = 4 * getJumpOffset(ifid.instruction);
-            jumpRegIndex = toDecimal(toBinary(ifid.instruction), 6, 11);
+// register reg as IDEX gets it for reader: bypassed from EX or MEM, else from the register file
+template<class Hooks>
+inline ll ProcSim<Hooks>::operand(int reg, ll reader) const {
+    // a load or lui in IDEX has nothing to bypass yet, and EX leaves aluResult as it was
+    if(writes(now.idex.instruction, reg) && reads(reader, reg))
+        return isRType(now.idex.instruction) ? executeResult() : now.exmem.aluResult;
+    else if(writes(now.exmem.instruction, reg) && reads(reader, reg))
+        return memoryResult();
+    return RF.rf[reg];
+}
 
-            
-            // Updating MEMWB
+/*
+    In IDEX, only PC, instruction and the values from the register
+    file are to be read.
+
+    Logic for forwarding is pretty straight-forward. While updating the
+    IDEX register, just check if the value to be used for calculating
+    aluResult or memory address is being written by the instructions
+    in IDEX and EXMEM, which EX and MEM work on in this cycle; see operand().
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::decodeStage(bool hazard) {
+    const IFID& ifid = now.ifid;
+    IDEX& idex = next.idex;
+
+    if(!hazard) {
+        idex.instruction = ifid.instruction;
+        idex.PC = ifid.PC;
+        idex.r1 = operand(getRS(ifid.instruction), ifid.instruction);
+        idex.r2 = operand(getRT(ifid.instruction), ifid.instruction);
+    }
+    else {
+        hazardStalls++;
+        idex.instruction = 0;
+        idex.PC = 0;
+        idex.r1 = 0;
+        idex.r2 = 0;
+    }
+}
 
-            memwb.instruction = exmem.instruction;
-            if(isRType(exmem.instruction)) {
-                memwb.writeRFAddress = getRD(exmem.instruction);
-                memwb.writeData = exmem.aluResult;
-            }
-            else if(isLoad(exmem.instruction)) {
-                memwb.writeRFAddress = getRT(exmem.instruction);
-                memwb.writeData = MEM.memory[exmem.loadMemoryAddress / 4];
-            }
-            else if(isLUI(exmem.instruction)) {
-                memwb.writeRFAddress = getRT(exmem.instruction);
-                memwb.writeData = toDecimal(toBinary(exmem.instruction), 16, 32) << 16;
-            }
-            memwb.PC = exmem.PC;
-
-            /*
-                The writeData in MEMWB depends on the previous instruction.
-                It can come from the Memory if the instruction is a load
-                and from the ALU if it is an R-type instruction. 
-
-                Also, we must copy the instruction from EXMEM register.
-            */
-
-            // Updating EXMEM
-
-
-            exmem.instruction = idex.instruction;
-            exmem.PC = idex.PC;
-
-            if(isRType(idex.instruction)) {
-                Operation op = getOperation(idex.instruction);
-                int offset = toDecimal(toBinary(idex.instruction), 21, 26);
-                if(op == ADD) 
-                    exmem.aluResult = idex.r1 + idex.r2;
-                else if(op == SUB)
-                    exmem.aluResult = idex.r1 - idex.r2;
-                else if(op == AND)
-                    exmem.aluResult = idex.r1 & idex.r2;
-                else if(op == OR)
-                    exmem.aluResult = idex.r1 | idex.r2;
-                else if(op == SLT)
-                    exmem.aluResult = idex.r1 < idex.r2 ? 1 : 0;
-                else if(op == SLL)
-                    exmem.aluResult = idex.r2 << offset;
-                else if(op == SRL)
-                    exmem.aluResult = idex.r2 >> offset;
+/*
+    The idea of continuing the execution of statements after the
+    branch is problematic. That is because of the possibility of
+    a jump just after the branch. The right way of solving this
+    problem is to stop execution until the branch condition
+    is truely known.
+
+    Algorithm:
+    1)  If a branch instruction appears at the IFID register,
+        stop PC updation
+    2)  When the instruction reaches EXMEM stage, it is possible
+        to know whether a branch is to be taken or not. Normal
+        process can resume from the EXMEM stage.
+
+    Two bubbles have to be inserted in the IFID register, then
+    control will be resumed after one cycle.
+*/
+template<class Hooks>
+inline void ProcSim<Hooks>::fetchStage(bool branchStall, bool hazard) {
+    const IFID& ifid = now.ifid;
+    ll PC = now.PC;
+    next.rfWrite.valid = false;
+    bool jumpPosition = isJump(ifid.instruction) || isJAL(ifid.instruction);
+    bool jumpReg = isJR(ifid.instruction);
+
+    if(!branchStall) {
+        if(!hazard) {
+            if(isJump(ifid.instruction) || isJR(ifid.instruction)) {
+                next.ifid.PC = 0;
+                next.ifid.instruction = 0;
             }
-            else if(isLoad(idex.instruction)) {
-                exmem.loadMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
+            else if(isJAL(ifid.instruction)) {
+                next.ifid.PC = 0;
+                next.ifid.instruction = 0;
+                // the return address, written when the cycle commits
+                next.rfWrite = {true, 31, PC};
             }
-            else if(isStore(idex.instruction)) {
-                exmem.writeMemoryAddress = idex.r1 + getWriteOffset(idex.instruction);
-                exmem.writeData = idex.r2;
+            else {
+                next.ifid.PC = PC;
+                next.ifid.instruction = IMEM.imem[PC / 4];
             }
-            else if(isBranch(idex.instruction)) {
-                if(isBEQ(idex.instruction) && idex.r1 == idex.r2) 
-                    exmem.branch = true;
-                else if(isBNE(idex.instruction) && idex.r1 != idex.r2) 
-                    exmem.branch = true;
-                else
-                    exmem.branch = false;
-                    
-                exmem.branchPC = idex.PC + 4 + getBranchOffset(idex.instruction) * 4;
+        }
+        // else remains the same as before.
+    }
+    else {
+        if(!hazard) {
+            branchStalls++;
+            next.ifid.PC = 0;
+            next.ifid.instruction = 0;
+        }
+    }
 
+    // Updating the PC; a taken branch is applied by commit()
+    if(!branchStall) {
+        if(!hazard) {
+            if(jumpPosition) {
+                jumpStalls++;
+                next.PC = 4 * getJumpOffset(ifid.instruction);
             }
-            
-            /*
-                In EXMEM, the things that have to be updated are the ALU results,
-                newly calculated PC, instruction, writeData for the memwb stage, 
-            */
-
-
-            // Updating IDEX
-
-
-            /*
-                Logic for forwarding is pretty straight-forward. 
-                While updating the EXMEM register, just check if the value
-                to be used for calculating aluResult or memory address is being 
-                written in by the instructions in exmem registers or memwb regs
-            */
-
-            if(!hazard) {
-                idex.instruction = ifid.instruction;
-                idex.PC = ifid.PC;
-                int rs = getRS(ifid.instruction);
-                int rt = getRT(ifid.instruction);
-
-                if(writes(exmem.instruction, rs) && reads(idex.instruction, rs)) 
-                    idex.r1 = exmem.aluResult;
-                else if(writes(memwb.instruction, rs) && reads(idex.instruction, rs))
-                    idex.r1 = memwb.writeData;
-                else 
-                    idex.r1 = RF.rf[rs];
-
-                if(writes(exmem.instruction, rt) && reads(idex.instruction, rt)) 
-                    idex.r2 = exmem.aluResult;
-                else if(writes(memwb.instruction, rt) && reads(idex.instruction, rt))
-                    idex.r2 = memwb.writeData;
-                else
-                    idex.r2 = RF.rf[rt];
-                    
+            else if(jumpReg) {
+                jumpStalls++;
+                next.PC = operand(getRS(ifid.instruction), ifid.instruction);
             }
             else {
-                idex.instruction = 0;
-                idex.PC = 0;
-                idex.r1 = 0;
-                idex.r2 = 0;
-            }
-            // else if hazard2, contents of the register remain same
-
-            /*
-                In IDEX, only PC, instruction and the values from the register
-                file are to be read.
-            */
-
-            // Updating IFID
-            jumpPosition = isJump(ifid.instruction) || isJAL(ifid.instruction);
-            jumpReg = isJR(ifid.instruction);
-
-            if(!branchStall) {
-                if(!hazard) {
-                    if(isJump(ifid.instruction)) {
-                        ifid.PC = 0;
-                        ifid.instruction = 0;
-                    }
-                    else if(isJAL(ifid.instruction)) {
-                        ifid.PC = 0;
-                        ifid.instruction = 0;
-                        RF.rf[31] = PC;
-                    }
-                    else if(isJR(ifid.instruction)) {
-                        vector<int> bin = toBinary(ifid.instruction);
-                        ifid.PC = 0;
-                        ifid.instruction = 0;
-                    }
-                    else {
-                        ifid.PC = PC;
-                        ifid.instruction = IMEM.imem[PC / 4];
-                    }
-                }
-                // else remains the same as before.
-            }
-            else {
-                if(!hazard) {
-                    ifid.PC = 0;
-                    ifid.instruction = 0;
-                }
+                next.PC = PC + 4;
             }
+        }
+        // else PC remains the same.
+    }
+
+    /*
+        It is important to remember that the offset of branch
+        is added to PC + 4 not directly to PC.
+    */
+}
 
+template<class Hooks>
+ll ProcSim<Hooks>::run(ll cycles) {
+    ll start = numCycles;
+    perf.begin(PHASE_SIMULATE);
+    while(!stop && (cycles == 0 || numCycles - start < cycles)
+            && (options.maxCycles == 0 || numCycles < options.maxCycles))
+        cycle();
+    perf.end(PHASE_SIMULATE);
+    return numCycles - start;
+}
 
-            // Updating the PC
-            if(branchStall && isBranch(exmem.instruction)) {
-                /* 
-                    Note that exmem.instruction has been executed in this cycle. 
-                    It is actually the value of IFID in the last cycle. 
-                */    
-                if(exmem.branch)
-                    PC = exmem.branchPC;
-                branchStall = false;
-            }
-            else if(!branchStall){
-                if(!hazard) {
-                    if(jumpPosition) {
-                        numStalls++;
-                        PC = jumpOffset;
-                    }
-                    else if(jumpReg) {
-                        numStalls++;
-                        PC = idex.r1;
-                    }
-                    else {
-                        PC = PC + 4;    
-                    }
-                }
-                // else PC remains the same.
-            }
+template<class Hooks>
+void ProcSim<Hooks>::finish() {
+    stats.finish(numCycles);
+    trace.finish(numCycles);
+    profile.finish(IMEM.imem);
+    callGraph.finish();
+    if constexpr (Hooks::enabled)
+        hooks.report(cerr);
+}
 
-            /*
-                It is important to remember that the offset of branch
-                is added to PC + 4 not directly to PC.
-            */ 
+}
 
-            stop = isNoop(ifid.instruction) && isNoop(memwb.instruction) 
-                    && isNoop(idex.instruction) && isNoop(exmem.instruction);
-            clk = 0;
-            numCycles++;
-            numInstr += !(isNoop(memwb.instruction));
-        }
-    }
-    writeLogs(numCycles, numInstr, RF.rf, MEM.memory);
-}
\ No newline at end of file
+unique_ptr<Core> newProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    if(options.hooksEnabled())
+        return unique_ptr<Core>(new ProcSim<MemoryHooks>(options, IMEM, MEM, perf));
+    return unique_ptr<Core>(new ProcSim<NoHooks>(options, IMEM, MEM, perf));
+}
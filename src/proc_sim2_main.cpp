@@ -0,0 +1,6 @@
+#include "batch.h"
+#include "decoupled.h"
+
+int main(int argc, char* argv[]) {
+    return simulatorMain(argc, argv, newProcSim2, runDecoupledProcSim2, runBatchProcSim2);
+}
@@ -0,0 +1,82 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "assembler.h"
+#include "profile.h"
+#include "textload.h"
+#define ll long long
+
+using namespace std;
+
+StallProfile::StallProfile(string file, string source, const InstructionMemory& IMEM) : file(file) {
+    enabled = file != "";
+    if(!enabled)
+        return;
+    lines.resize(IMEM.count);
+
+    string code;
+    if(source == "") {
+        source = IMEM.source;
+        sourceLines = IMEM.lines;
+    }
+    else if(readWholeFile(source, code)) {
+        // assembled again for its line numbers
+        Assembly assembly = assembleSource(code);
+        if(assembly.ok())
+            sourceLines = assembly.lines;
+        else
+            cerr << source << " does not assemble; the profile shows mnemonics" << endl;
+    }
+    else
+        cerr << "cannot read " << source << " for the profile" << endl;
+    if(!sourceLines.empty()) {
+        ifstream src (source);
+        for(string s; getline(src, s); )
+            text.push_back(s);
+    }
+}
+
+void StallProfile::watchStalls(const ll* hazard, const ll* branch, const ll* jump, const ll* loadMiss) {
+    counters[PROFILE_HAZARD] = hazard;
+    counters[PROFILE_BRANCH] = branch;
+    counters[PROFILE_JUMP] = jump;
+    counters[PROFILE_LOAD_MISS] = loadMiss;
+}
+
+void StallProfile::finish(vector<ll>& imem) {
+    if(!enabled)
+        return;
+    FILE* out = fopen(file.c_str(), "w");
+    if(out == nullptr) {
+        cerr << "cannot write profile to " << file << endl;
+        return;
+    }
+
+    ProfileLine total;
+    fprintf(out, "%5s %6s %10s %10s %10s %8s %8s %8s %8s  %s\n", "line", "pc", "cycles", "execs",
+            "stalls", "hazard", "branch", "jump", "miss", "source");
+    for(size_t i = 0; i < lines.size(); i++) {
+        ProfileLine& l = lines[i];
+        ll stalls = 0;
+        for(int c = 0; c < PROFILE_CAUSES; c++) {
+            stalls += l.stalls[c];
+            total.stalls[c] += l.stalls[c];
+        }
+        total.executions += l.executions;
+        int line = i < sourceLines.size() ? sourceLines[i] : 0;
+        if(l.executions == 0 && stalls == 0 && line == 0)
+            continue;
+        string what = line > 0 && line <= (int) text.size() ? text[line - 1]
+                : mnemonic(i < imem.size() ? imem[i] : 0);
+        fprintf(out, "%5s %6zu %10lld %10lld %10lld %8lld %8lld %8lld %8lld  %s\n", line > 0 ? to_string(line).c_str() : "-", i * 4,
+                l.executions + stalls, l.executions, stalls, l.stalls[PROFILE_HAZARD],
+                l.stalls[PROFILE_BRANCH], l.stalls[PROFILE_JUMP], l.stalls[PROFILE_LOAD_MISS], what.c_str());
+    }
+    ll stalls = 0;
+    for(int c = 0; c < PROFILE_CAUSES; c++)
+        stalls += total.stalls[c];
+    fprintf(out, "%5s %6s %10lld %10lld %10lld %8lld %8lld %8lld %8lld\n", "total", "",
+            total.executions + stalls, total.executions, stalls, total.stalls[PROFILE_HAZARD],
+            total.stalls[PROFILE_BRANCH], total.stalls[PROFILE_JUMP], total.stalls[PROFILE_LOAD_MISS]);
+    fclose(out);
+}
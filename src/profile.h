@@ -0,0 +1,94 @@
+#ifndef PROFILE_HEADER
+#define PROFILE_HEADER
+
+#include <string>
+#include <vector>
+#include "instruction.h"
+#include "memory.h"
+#define ll long long
+using namespace std;
+
+/*
+    Per-PC stall attribution. Every bubble is charged to the static
+    instruction responsible for it:
+
+    hazard     the instruction held in IFID waiting for an operand
+    branch     the branch being resolved
+    jump       the j, jal or jr that left a bubble behind it
+    load miss  the load in EXMEM waiting for memory (proc_sim3)
+
+    The listing gives, per instruction, executions (instructions reaching
+    write back), the stalls charged to it and cycles = executions + stalls,
+    so the column sums to the run's cycles less the pipeline fill. Each
+    row shows the source line the instruction was assembled from, by the
+    line numbers the assembler keeps, so comments and labels do not shift
+    it; without source the row shows the decoded mnemonic.
+*/
+
+enum ProfileCause {PROFILE_HAZARD, PROFILE_BRANCH, PROFILE_JUMP, PROFILE_LOAD_MISS, PROFILE_CAUSES};
+
+struct ProfileLine {
+    ll executions = 0;
+    ll stalls[PROFILE_CAUSES] = {0, 0, 0, 0};
+};
+
+class StallProfile {
+public:
+    /*
+        No file disables profiling; cycle() must then not be called. The
+        source is the assembly of IMEM, or "" for the one IMEM was
+        assembled from, if any.
+    */
+    StallProfile(string file, string source, const InstructionMemory& IMEM);
+
+    // the simulator's stall counters, as for PipelineTrace; any may be null
+    void watchStalls(const ll* hazard, const ll* branch, const ll* jump, const ll* loadMiss);
+
+    // call after the latches were updated at the end of a cycle
+    template<class IFIDLatch, class IDEXLatch, class EXMEMLatch, class MEMWBLatch>
+    void cycle(const IFIDLatch& ifid, const IDEXLatch& idex, const EXMEMLatch& exmem,
+            const MEMWBLatch& memwb, bool retired) {
+        if(isBranch(ifid.instruction))
+            lastBranch = ifid.PC;
+        if(retired)
+            line(memwb.PC).executions++;
+        if(changed(PROFILE_HAZARD))
+            line(ifid.PC).stalls[PROFILE_HAZARD]++;
+        if(changed(PROFILE_BRANCH))
+            line(lastBranch).stalls[PROFILE_BRANCH]++;
+        if(changed(PROFILE_JUMP))
+            line(idex.PC).stalls[PROFILE_JUMP]++;
+        if(changed(PROFILE_LOAD_MISS))
+            line(exmem.PC).stalls[PROFILE_LOAD_MISS]++;
+    }
+
+    // writes the annotated listing
+    void finish(vector<ll>& imem);
+
+    bool enabled = false;
+    vector<ProfileLine> lines;  // indexed by PC / 4
+
+private:
+    inline ProfileLine& line(ll pc) {
+        size_t index = pc / 4;
+        if(index >= lines.size())
+            lines.resize(index + 1);
+        return lines[index];
+    }
+
+    inline bool changed(int cause) {
+        if(counters[cause] == nullptr || *counters[cause] == seen[cause])
+            return false;
+        seen[cause] = *counters[cause];
+        return true;
+    }
+
+    string file;
+    vector<string> text;        // of the source
+    vector<int> sourceLines;    // 1-based line in text, by PC / 4
+    ll lastBranch = 0;
+    const ll* counters[PROFILE_CAUSES] = {nullptr, nullptr, nullptr, nullptr};
+    ll seen[PROFILE_CAUSES] = {0, 0, 0, 0};
+};
+
+#endif
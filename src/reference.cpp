@@ -0,0 +1,66 @@
+#include "instruction.h"
+#include "reference.h"
+#define ll long long
+
+using namespace std;
+
+ll executeInstruction(ll instruction, ll PC, vector<ll>& rf, Memory& MEM) {
+    ll next = PC + 4;
+    int rs = getRS(instruction), rt = getRT(instruction);
+
+    if(isRType(instruction)) {
+        ll shamt = (instruction >> 6) & 31;
+        ll value = 0;
+        switch(getOperation(instruction)) {
+        case ADD: value = rf[rs] + rf[rt]; break;
+        case SUB: value = rf[rs] - rf[rt]; break;
+        case AND: value = rf[rs] & rf[rt]; break;
+        case OR:  value = rf[rs] | rf[rt]; break;
+        case SLT: value = rf[rs] < rf[rt] ? 1 : 0; break;
+        case SLL: value = rf[rt] << shamt; break;
+        case SRL: value = rf[rt] >> shamt; break;
+        case NOOP: break;
+        }
+        rf[getRD(instruction)] = value;
+    }
+    else if(isLoad(instruction))
+        rf[rt] = MEM.memory[(rf[rs] + getWriteOffset(instruction)) / 4];
+    else if(isStore(instruction))
+        MEM.store((rf[rs] + getWriteOffset(instruction)) / 4, rf[rt]);
+    else if(isLUI(instruction))
+        rf[rt] = getWriteOffset(instruction) << 16;
+    else if(isBranch(instruction)) {
+        bool taken = isBEQ(instruction) ? rf[rs] == rf[rt] : rf[rs] != rf[rt];
+        if(taken)
+            next = PC + 4 + getBranchOffset(instruction) * 4;
+    }
+    else if(isJump(instruction))
+        next = 4 * getJumpOffset(instruction);
+    else if(isJAL(instruction)) {
+        rf[31] = PC + 4;
+        next = 4 * getJumpOffset(instruction);
+    }
+    else if(isJR(instruction))
+        next = rf[rs];
+    return next;
+}
+
+SimResult runReference(const InstructionMemory& IMEM, Memory& MEM, ll maxInstructions) {
+    SimResult result;
+    vector<ll>& rf = result.rf;
+    rf = vector<ll>(32, 0);
+    ll PC = 0;
+    result.finished = false;
+    while(maxInstructions == 0 || result.instructions < maxInstructions) {
+        size_t index = PC / 4;
+        ll instruction = PC >= 0 && index < IMEM.imem.size() ? IMEM.imem[index] : 0;
+        if(isNoop(instruction)) {
+            result.finished = true;
+            break;
+        }
+        result.instructions++;
+        PC = executeInstruction(instruction, PC, rf, MEM);
+    }
+    result.cycles = result.instructions;
+    return result;
+}
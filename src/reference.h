@@ -0,0 +1,29 @@
+#ifndef REFERENCE_HEADER
+#define REFERENCE_HEADER
+
+#include "memory.h"
+#include "simulator.h"
+#define ll long long
+using namespace std;
+
+/*
+    Functional model of the instruction set the pipelines implement: one
+    instruction at a time, no latches, no timing. The pipelines must end
+    with the same registers, memory and instruction count, which is what
+    the differential fuzzer checks.
+
+    Semantics follow the pipelines rather than MIPS where they differ:
+    registers are 64-bit, srl shifts arithmetically, offsets and lui
+    immediates are unsigned, jal links the address after itself and $zero
+    is an ordinary register. The program ends at the first noop, where the
+    pipelines find nothing left in flight.
+
+    cycles is the number of instructions executed; finished is false if
+    maxInstructions (0 for no limit) was reached first.
+*/
+SimResult runReference(const InstructionMemory& IMEM, Memory& MEM, ll maxInstructions = 0);
+
+// executes one instruction at PC on rf and MEM and returns the next PC
+ll executeInstruction(ll instruction, ll PC, vector<ll>& rf, Memory& MEM);
+
+#endif
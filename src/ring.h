@@ -0,0 +1,69 @@
+#ifndef RING_HEADER
+#define RING_HEADER
+
+#include <atomic>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/*
+    Lock-free ring buffer for exactly one producer thread and one consumer
+    thread. The capacity is rounded up to a power of two. push() waits for
+    space, which is how a slow consumer applies back-pressure.
+*/
+template<class T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) {
+        size_t size = 1;
+        while(size < capacity)
+            size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    bool tryPush(const T& value) {
+        size_t t = tail.load(memory_order_relaxed);
+        if(t - cachedHead == slots.size()) {
+            cachedHead = head.load(memory_order_acquire);
+            if(t - cachedHead == slots.size())
+                return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        size_t h = head.load(memory_order_relaxed);
+        if(h == cachedTail) {
+            cachedTail = tail.load(memory_order_acquire);
+            if(h == cachedTail)
+                return false;
+        }
+        value = slots[h & mask];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    void push(const T& value) {
+        while(!tryPush(value))
+            this_thread::yield();
+    }
+
+    bool empty() const {
+        return head.load(memory_order_acquire) == tail.load(memory_order_acquire);
+    }
+
+private:
+    vector<T> slots;
+    size_t mask;
+    // each index lives on its own cache line next to the copy of the other
+    // index that only its owner reads
+    alignas(64) atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    alignas(64) atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <stdexcept>
+#include "assembler.h"
+#include "elfload.h"
+#include "image.h"
+#include "simulator.h"
+#include "textload.h"
+#define ll long long
+
+using namespace std;
+
+SimResult Core::result() const {
+    SimResult result;
+    Counters c = counters();
+    result.cycles = c.cycles;
+    result.instructions = c.instructions;
+    result.rf = registers();
+    result.finished = halted();
+    return result;
+}
+
+// a pipeline of IMEM that starts where and as the program asks
+static unique_ptr<Core> startCore(CoreFactory pipeline, const Options& options, InstructionMemory& IMEM,
+        Memory& MEM, HostPerf& perf) {
+    unique_ptr<Core> core = pipeline(options, IMEM, MEM, perf);
+    if(IMEM.entry != 0 || IMEM.stackPointer != 0 || IMEM.globalPointer != 0) {
+        vector<ll> rf(32, 0);
+        rf[28] = IMEM.globalPointer;
+        rf[29] = IMEM.stackPointer;
+        core->restore(IMEM.entry, rf);
+    }
+    return core;
+}
+
+Simulator::Simulator(CoreFactory pipeline, const Options& options)
+        : options(options), perf(options.perf), pipeline(pipeline) {}
+
+void Simulator::load(const ll* program, size_t programWords, const ll* memory, size_t memoryWords) {
+    load(program, programWords, make_shared<const MemoryImage>(memory, memoryWords));
+}
+
+void Simulator::load(const vector<ll>& program, const vector<ll>& memory) {
+    load(program.data(), program.size(), memory.data(), memory.size());
+}
+
+void Simulator::load(const ll* program, size_t programWords, shared_ptr<const MemoryImage> memory) {
+    core.reset();
+    memoryLoad.reset();
+    IMEM.reset(new InstructionMemory(program, programWords));
+    MEM.reset(new Memory(memory));
+    start();
+}
+
+void Simulator::load(const vector<ll>& program, shared_ptr<const MemoryImage> memory) {
+    load(program.data(), program.size(), memory);
+}
+
+bool Simulator::loadFiles(const string& program, const string& memory, string& error) {
+    core.reset();
+    memoryLoad.reset();
+    if(isImageFile(memory) || isElfFile(memory)) {
+        MEM.reset(new Memory(memory));
+        // the reason is on stderr already
+        if(!MEM->valid) {
+            error = "cannot load memory from " + memory + "\n";
+            return false;
+        }
+    }
+    else {
+        MEM.reset(new Memory((size_t) MEMORY_SIZE));
+        memoryLoad.reset(new AsyncMemoryLoad(*MEM, memory));
+    }
+    if(isAssemblyFile(program)) {
+        string source;
+        if(!readWholeFile(program, source)) {
+            error = "cannot read " + program + "\n";
+            return false;
+        }
+        // programs given as .s are assembled straight into instruction memory
+        Assembly assembly = assembleSource(source);
+        if(!assembly.ok()) {
+            error = assembly.report(program);
+            return false;
+        }
+        IMEM.reset(new InstructionMemory(assembly.words));
+        IMEM->source = program;
+        IMEM->lines = assembly.lines;
+    }
+    else {
+        IMEM.reset(new InstructionMemory(program));
+        if(!IMEM->valid) {
+            error = "cannot load instructions from " + program + "\n";
+            return false;
+        }
+    }
+    start();
+    return true;
+}
+
+void Simulator::start() {
+    core = startCore(pipeline, options, *IMEM, *MEM, perf);
+}
+
+ll Simulator::run(ll cycles) {
+    if(core == nullptr)
+        throw logic_error("Simulator::run before load");
+    if(memoryLoad != nullptr)
+        memoryLoad->ready();
+    return core->run(cycles);
+}
+
+bool Simulator::step() {
+    return run(1) == 1 && !core->halted();
+}
+
+bool Simulator::halted() const {
+    return core == nullptr || core->halted();
+}
+
+ll Simulator::reg(int index) const {
+    return core->registers().at(index);
+}
+
+const vector<ll>& Simulator::registers() const {
+    return core->registers();
+}
+
+vector<ll> Simulator::readMemory(size_t index, size_t count) const {
+    if(index >= MEM->size)
+        return vector<ll>();
+    count = min(count, MEM->size - index);
+    if(memoryLoad != nullptr)
+        memoryLoad->ready();
+    return vector<ll>(MEM->memory + index, MEM->memory + index + count);
+}
+
+Latches Simulator::latches() const {
+    return core->latches();
+}
+
+Counters Simulator::counters() const {
+    return core->counters();
+}
+
+Memory& Simulator::memory() {
+    if(memoryLoad != nullptr)
+        memoryLoad->ready();
+    return *MEM;
+}
+
+SimResult Simulator::finish() {
+    // the dump may hand the memory to write()
+    memory();
+    core->finish();
+    return core->result();
+}
+
+void Simulator::report(ostream& out) const {
+    core->report(out);
+}
+
+SimResult runCore(CoreFactory pipeline, const Options& options, InstructionMemory& IMEM,
+        Memory& MEM, HostPerf& perf) {
+    unique_ptr<Core> core = startCore(pipeline, options, IMEM, MEM, perf);
+    core->run(0);
+    core->finish();
+    return core->result();
+}
+
+SimResult runProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runCore(newProcSim1, options, IMEM, MEM, perf);
+}
+
+SimResult runProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runCore(newProcSim2, options, IMEM, MEM, perf);
+}
+
+SimResult runProcSim3(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf) {
+    return runCore(newProcSim3, options, IMEM, MEM, perf);
+}
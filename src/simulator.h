@@ -0,0 +1,194 @@
+#ifndef SIMULATOR_HEADER
+#define SIMULATOR_HEADER
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "asyncload.h"
+#include "memory.h"
+#include "options.h"
+#include "perf.h"
+#define ll long long
+using namespace std;
+
+/*
+    libmipssim: the three pipelines as a library, so that they can be driven
+    from C++ tooling (the test runner runs many of them on a thread pool) as
+    well as behind the bin/proc_simN command lines:
+
+        proc_sim1       no forwarding
+        proc_sim2       forwarding
+        proc_sim3       forwarding, loads miss at random
+
+    A Simulator owns the program, the memory and a pipeline Core. It can be
+    loaded from files or from buffers, run for a number of cycles or until
+    the program halts, stepped a cycle at a time, and queried for registers,
+    memory, latches and counters in between:
+
+        Simulator sim(newProcSim2);
+        sim.load(program, memory);
+        while(sim.step())
+            if(sim.latches().memwb.instruction != 0) ...
+        SimResult result = sim.finish();
+
+    Stats, traces and profiles are written as the options ask when the run
+    is finished; the final state dump is left to the caller.
+*/
+
+// the random load misses of proc_sim3, which the timing model (timing.h)
+// replays: a load hits with probability x, a miss takes N cycles
+#define PROC_SIM3_X 0.4
+#define PROC_SIM3_N 3
+
+struct SimResult {
+    ll cycles = 0, instructions = 0;
+    vector<ll> rf;
+    bool finished = true;   // false if stopped by --max-cycles
+};
+
+// the pipeline registers after the last completed cycle
+struct Latches {
+    ll PC;      // address of the next fetch
+    struct { ll PC, instruction; } ifid;
+    struct { ll PC, instruction, r1, r2; } idex;
+    struct {
+        ll PC, instruction, aluResult, writeData, branchPC, loadMemoryAddress, writeMemoryAddress;
+        bool branch;
+    } exmem;
+    struct { ll PC, instruction, writeData, writeRFAddress; } memwb;
+};
+
+struct Counters {
+    ll cycles, instructions;
+    ll hazardStalls, branchStalls, jumpStalls, loadStalls;
+};
+
+// a pipeline over an InstructionMemory and a Memory it does not own
+class Core {
+public:
+    virtual ~Core() = default;
+    /*
+        Runs up to cycles cycles, or until the program halts if cycles is 0,
+        and returns the number of cycles run. Options::maxCycles bounds the
+        whole run.
+    */
+    virtual ll run(ll cycles) = 0;
+    // writes stats, traces and profiles; call once at the end of the run
+    virtual void finish() = 0;
+    virtual bool halted() const = 0;
+    virtual const vector<ll>& registers() const = 0;
+    /*
+        Before the first run: starts fetching at PC at with the registers rf
+        instead of at 0 with zeros, for runs from a checkpoint of the
+        program's architectural state (see interval.h).
+    */
+    virtual void restore(ll at, const vector<ll>& rf) = 0;
+    virtual Latches latches() const = 0;
+    virtual Counters counters() const = 0;
+    // lines for stderr after finish() about what options turned on
+    virtual void report(ostream&) const {}
+
+    SimResult result() const;
+};
+
+typedef unique_ptr<Core> (*CoreFactory)(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+
+unique_ptr<Core> newProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+unique_ptr<Core> newProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+unique_ptr<Core> newProcSim3(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+
+template<class IFIDLatch, class IDEXLatch, class EXMEMLatch, class MEMWBLatch>
+Latches latchState(ll PC, const IFIDLatch& ifid, const IDEXLatch& idex, const EXMEMLatch& exmem,
+        const MEMWBLatch& memwb) {
+    return {PC, {ifid.PC, ifid.instruction}, {idex.PC, idex.instruction, idex.r1, idex.r2},
+            {exmem.PC, exmem.instruction, exmem.aluResult, exmem.writeData, exmem.branchPC,
+             exmem.loadMemoryAddress, exmem.writeMemoryAddress, exmem.branch},
+            {memwb.PC, memwb.instruction, memwb.writeData, memwb.writeRFAddress}};
+}
+
+class Simulator {
+public:
+    Simulator(CoreFactory pipeline, const Options& options = Options());
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+
+    /*
+        The program as instruction words from address 0 and the initial
+        memory as words from address 0, the rest zero. Both are copied once,
+        the buffers are not kept: the pipelines fetch from a padded
+        instruction vector and stores need a private copy of the memory.
+        Use the MemoryImage overloads to run many simulators on one memory
+        without further copies.
+    */
+    void load(const ll* program, size_t programWords, const ll* memory, size_t memoryWords);
+    void load(const vector<ll>& program, const vector<ll>& memory);
+    // memory is shared copy-on-write with every other user of the image
+    void load(const ll* program, size_t programWords, shared_ptr<const MemoryImage> memory);
+    void load(const vector<ll>& program, shared_ptr<const MemoryImage> memory);
+    /*
+        The files of the command line: the program as assembly (.s, .asm),
+        decimal words, a binary image or a MIPS executable, the memory as
+        "pos-val" lines, an image or an executable (see elfload.h). Returns
+        false with error set if the program does not assemble or an image or
+        executable is rejected.
+        A text memory loads on another thread while the program is read and
+        the pipeline is built; the first run waits for it, see asyncload.h.
+    */
+    bool loadFiles(const string& program, const string& memory, string& error);
+
+    // as Core::run; 0 runs until the program halts
+    ll run(ll cycles = 0);
+    // one cycle; false once the program has halted
+    bool step();
+    bool halted() const;
+
+    ll reg(int index) const;
+    const vector<ll>& registers() const;
+    // count words from word address index, as the memory file numbers them
+    vector<ll> readMemory(size_t index, size_t count) const;
+    Latches latches() const;
+    Counters counters() const;
+    // MEM once it is completely loaded, for runs outside of the Simulator
+    Memory& memory();
+
+    // ends the run, see Core::finish
+    SimResult finish();
+    // see Core::report
+    void report(ostream& out) const;
+
+    Options options;
+    HostPerf perf;
+    unique_ptr<InstructionMemory> IMEM;
+    unique_ptr<Memory> MEM;
+    unique_ptr<AsyncMemoryLoad> memoryLoad;     // of MEM, if it is loading
+
+private:
+    void start();
+    CoreFactory pipeline;
+    unique_ptr<Core> core;
+};
+
+// whole runs, for callers that need nothing in between
+typedef SimResult (*Pipeline)(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+
+SimResult runCore(CoreFactory pipeline, const Options& options, InstructionMemory& IMEM, Memory& MEM,
+        HostPerf& perf);
+
+SimResult runProcSim1(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+SimResult runProcSim2(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+SimResult runProcSim3(const Options& options, InstructionMemory& IMEM, Memory& MEM, HostPerf& perf);
+
+// runs of one program on many memories (see batch.h)
+struct BatchStats;
+typedef vector<SimResult> (*BatchPipeline)(const Options& options, InstructionMemory& IMEM,
+        const vector<Memory*>& MEM, HostPerf& perf, BatchStats* stats);
+
+/*
+    The command line of bin/proc_simN (see options.h) around pipeline, or
+    around decoupled (see decoupled.h) with --decoupled, or in intervals
+    (see interval.h) with --interval, or around batch with --batch.
+*/
+int simulatorMain(int argc, char* argv[], CoreFactory pipeline, Pipeline decoupled, BatchPipeline batch);
+
+#endif
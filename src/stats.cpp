@@ -0,0 +1,110 @@
+#include <iostream>
+#include "stats.h"
+#define ll long long
+
+using namespace std;
+
+Stats::Stats(string file, string format, ll interval) : interval(interval) {
+    json = format != "csv";
+    if(file == "")
+        return;
+    out.open(file);
+    if(!out.is_open())
+        cerr << "cannot write statistics to " << file << endl;
+    else if(interval > 0)
+        nextSnapshot = interval;
+}
+
+void Stats::counter(string name, string description, const ll* value) {
+    entries.push_back({name, description, value, nullptr, nullptr});
+}
+
+Histogram& Stats::histogram(string name, string description, ll width, int buckets) {
+    histograms.emplace_back(width, buckets);
+    entries.push_back({name, description, nullptr, &histograms.back(), nullptr});
+    return histograms.back();
+}
+
+void Stats::formula(string name, string description, function<double()> f) {
+    entries.push_back({name, description, nullptr, nullptr, f});
+}
+
+double Stats::value(string name) const {
+    for(const Entry& e : entries) {
+        if(e.name != name)
+            continue;
+        if(e.counter != nullptr)
+            return *e.counter;
+        if(e.formula)
+            return e.formula();
+        return e.histogram->samples;
+    }
+    return 0;
+}
+
+static string bucketName(const string& name, const Histogram& h, size_t i) {
+    string hi = i + 1 == h.counts.size() ? "" : to_string((i + 1) * h.width);
+    return name + "[" + to_string(i * h.width) + "-" + hi + ")";
+}
+
+void Stats::write(ll cycle, bool final) {
+    if(!out.is_open())
+        return;
+    if(json) {
+        out << "{\"cycle\": " << cycle;
+        for(Entry& e : entries) {
+            out << ", \"" << e.name << "\": ";
+            if(e.counter != nullptr)
+                out << *e.counter;
+            else if(e.formula)
+                out << e.formula();
+            else {
+                Histogram& h = *e.histogram;
+                out << "{\"width\": " << h.width << ", \"samples\": " << h.samples
+                    << ", \"sum\": " << h.sum << ", \"counts\": [";
+                for(size_t i = 0; i < h.counts.size(); i++)
+                    out << (i ? ", " : "") << h.counts[i];
+                out << "]}";
+            }
+        }
+        if(final) {
+            out << ", \"final\": true, \"descriptions\": {";
+            for(size_t i = 0; i < entries.size(); i++)
+                out << (i ? ", " : "") << "\"" << entries[i].name << "\": \"" << entries[i].description << "\"";
+            out << "}";
+        }
+        out << "}\n";
+    }
+    else {
+        if(!headerWritten) {
+            out << "snapshot,cycle";
+            for(Entry& e : entries) {
+                if(e.histogram == nullptr)
+                    out << "," << e.name;
+                else {
+                    for(size_t i = 0; i < e.histogram->counts.size(); i++)
+                        out << "," << bucketName(e.name, *e.histogram, i);
+                }
+            }
+            out << "\n";
+            headerWritten = true;
+        }
+        out << (final ? "final" : "interval") << "," << cycle;
+        for(Entry& e : entries) {
+            if(e.counter != nullptr)
+                out << "," << *e.counter;
+            else if(e.formula)
+                out << "," << e.formula();
+            else {
+                for(ll c : e.histogram->counts)
+                    out << "," << c;
+            }
+        }
+        out << "\n";
+    }
+}
+
+void Stats::finish(ll cycle) {
+    write(cycle, true);
+    out.flush();
+}
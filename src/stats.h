@@ -0,0 +1,84 @@
+#ifndef STATS_HEADER
+#define STATS_HEADER
+
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Statistics registry. Stages register the counters they already keep
+    (by address, so counting stays a plain increment), histograms and
+    formulas derived from them. The registry is written when the run ends
+    and, with an interval, every interval cycles while it runs:
+
+    json    one JSON object per line: {"cycle": N, "name": value, ...};
+            the last line also has "final": true and the descriptions
+    csv     a header line, then one row per snapshot; histogram buckets
+            become columns "name[lo-hi)"
+*/
+
+class Histogram {
+public:
+    Histogram(ll width, int buckets) : width(width), counts(buckets, 0) {}
+
+    // the last bucket also holds everything above the range
+    inline void sample(ll value) {
+        size_t bucket = value < 0 ? 0 : value / width;
+        if(bucket >= counts.size())
+            bucket = counts.size() - 1;
+        counts[bucket]++;
+        samples++;
+        sum += value;
+    }
+
+    ll width;
+    vector<ll> counts;
+    ll samples = 0, sum = 0;
+};
+
+class Stats {
+public:
+    // format "json" or "csv"; no file means nothing is written
+    Stats(string file = "", string format = "json", ll interval = 0);
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+
+    void counter(string name, string description, const ll* value);
+    Histogram& histogram(string name, string description, ll width, int buckets);
+    void formula(string name, string description, function<double()> f);
+
+    // call once per simulated cycle
+    inline void tick(ll cycle) {
+        if(cycle == nextSnapshot) {
+            write(cycle, false);
+            nextSnapshot += interval;
+        }
+    }
+
+    void finish(ll cycle);
+    // current value of a counter or formula, for tools that read it directly
+    double value(string name) const;
+
+    struct Entry {
+        string name, description;
+        const ll* counter;
+        Histogram* histogram;
+        function<double()> formula;
+    };
+    vector<Entry> entries;
+
+private:
+    void write(ll cycle, bool final);
+    ofstream out;
+    bool json = true;
+    bool headerWritten = false;
+    ll interval = 0;
+    ll nextSnapshot = -1;
+    deque<Histogram> histograms;
+};
+
+#endif
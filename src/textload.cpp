@@ -0,0 +1,181 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <thread>
+#include <utility>
+#include "textload.h"
+#define ll long long
+
+using namespace std;
+
+bool readWholeFile(string file, string& buffer) {
+    FILE* f = fopen(file.c_str(), "rb");
+    if(f == nullptr)
+        return false;
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buffer.resize(length > 0 ? length : 0);
+    size_t got = fread(&buffer[0], 1, buffer.size(), f);
+    buffer.resize(got);
+    fclose(f);
+    return true;
+}
+
+static inline const char* skipBlanks(const char* p, const char* end) {
+    while(p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+static inline const char* nextLine(const char* p, const char* end) {
+    while(p < end && *p != '\n')
+        p++;
+    return p < end ? p + 1 : end;
+}
+
+// reads a decimal, optionally signed with '+' or '-', like stoll
+static inline const char* parseNumber(const char* p, const char* end, ll& value, bool& ok) {
+    p = skipBlanks(p, end);
+    bool negative = false;
+    if(p < end && (*p == '+' || *p == '-')) {
+        negative = *p == '-';
+        p++;
+    }
+    unsigned long long magnitude = 0;
+    from_chars_result r = from_chars(p, end, magnitude);
+    ok = r.ec == errc();
+    value = negative ? -(ll) magnitude : (ll) magnitude;
+    return r.ptr;
+}
+
+/*
+    Splits [begin, end) into at most n chunks that start at the beginning
+    of a line.
+*/
+static vector<pair<const char*, const char*>> splitLines(const char* begin, const char* end, unsigned n) {
+    vector<pair<const char*, const char*>> chunks;
+    const char* start = begin;
+    size_t step = (end - begin) / n + 1;
+    while(start < end) {
+        const char* stop = start + step < end ? nextLine(start + step, end) : end;
+        chunks.push_back({start, stop});
+        start = stop;
+    }
+    return chunks;
+}
+
+static unsigned parseThreads(size_t bytes) {
+    if(bytes < PARALLEL_PARSE_BYTES)
+        return 1;
+    unsigned n = thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+/*
+    Sets bad to the first line that is neither blank nor a number and stops
+    there: dropping it would move every later instruction, and with it
+    every branch target, up by one word.
+*/
+static void instructionChunk(const char* p, const char* end, vector<ll>& words, const char*& bad) {
+    bad = nullptr;
+    while(p < end) {
+        const char* text = skipBlanks(p, end);
+        if(text == end || *text == '\n') {
+            p = nextLine(text, end);
+            continue;
+        }
+        ll value;
+        bool ok;
+        const char* q = parseNumber(p, end, value, ok);
+        if(!ok) {
+            bad = p;
+            return;
+        }
+        words.push_back(value);
+        p = nextLine(q, end);
+    }
+}
+
+size_t parseInstructions(const string& buffer, vector<ll>& words) {
+    const char* begin = buffer.data();
+    const char* end = begin + buffer.size();
+    unsigned n = parseThreads(buffer.size());
+    const char* bad = nullptr;
+    if(n == 1) {
+        words.reserve(words.size() + buffer.size() / 11);
+        instructionChunk(begin, end, words, bad);
+    }
+    else {
+        vector<pair<const char*, const char*>> chunks = splitLines(begin, end, n);
+        vector<vector<ll>> parts(chunks.size());
+        vector<const char*> bads(chunks.size());
+        vector<thread> workers;
+        for(size_t c = 0; c < chunks.size(); c++)
+            workers.emplace_back(instructionChunk, chunks[c].first, chunks[c].second, ref(parts[c]), ref(bads[c]));
+        for(thread& t : workers)
+            t.join();
+        for(size_t c = 0; c < chunks.size() && bad == nullptr; c++) {
+            words.insert(words.end(), parts[c].begin(), parts[c].end());
+            bad = bads[c];
+        }
+    }
+    // lines are only counted for the error
+    return bad == nullptr ? 0 : count(begin, bad, '\n') + 1;
+}
+
+// calls store(pos, val) for every well-formed "pos-val" line
+template<class F>
+static void scanMemory(const char* p, const char* end, F store) {
+    while(p < end) {
+        ll pos, val;
+        bool ok;
+        const char* q = parseNumber(p, end, pos, ok);
+        q = skipBlanks(q, end);
+        if(ok && q < end && *q == '-') {
+            q = parseNumber(q + 1, end, val, ok);
+            if(ok)
+                store(pos, val);
+        }
+        p = nextLine(q, end);
+    }
+}
+
+static void memoryChunk(const char* p, const char* end, vector<pair<ll, ll>>& entries) {
+    scanMemory(p, end, [&](ll pos, ll val) { entries.push_back({pos, val}); });
+}
+
+static void applyEntries(const vector<pair<ll, ll>>& entries, ll* memory, size_t size) {
+    for(const pair<ll, ll>& e : entries) {
+        if(e.first >= 0 && (size_t) e.first < size)
+            memory[e.first] = e.second;
+    }
+}
+
+void parseMemory(const string& buffer, ll* memory, size_t size) {
+    const char* begin = buffer.data();
+    const char* end = begin + buffer.size();
+    unsigned n = parseThreads(buffer.size());
+    if(n == 1) {
+        // store directly, no intermediate entry list
+        scanMemory(begin, end, [&](ll pos, ll val) {
+            if(pos >= 0 && (size_t) pos < size)
+                memory[pos] = val;
+        });
+        return;
+    }
+
+    /*
+        Chunks are parsed in parallel but applied in file order, so a
+        position that appears twice keeps its last value as before.
+    */
+    vector<pair<const char*, const char*>> chunks = splitLines(begin, end, n);
+    vector<vector<pair<ll, ll>>> parts(chunks.size());
+    vector<thread> workers;
+    for(size_t c = 0; c < chunks.size(); c++)
+        workers.emplace_back(memoryChunk, chunks[c].first, chunks[c].second, ref(parts[c]));
+    for(thread& t : workers)
+        t.join();
+    for(vector<pair<ll, ll>>& part : parts)
+        applyEntries(part, memory, size);
+}
@@ -0,0 +1,28 @@
+#ifndef TEXTLOAD_HEADER
+#define TEXTLOAD_HEADER
+
+#include <string>
+#include <vector>
+#define ll long long
+using namespace std;
+
+/*
+    Parsers for the text input formats. The file is read with a single bulk
+    read and parsed in place with from_chars, without allocating per line.
+    Inputs larger than PARALLEL_PARSE_BYTES are split at line boundaries
+    and the chunks are parsed on separate threads.
+*/
+
+#define PARALLEL_PARSE_BYTES (8 << 20)
+
+bool readWholeFile(string file, string& buffer);
+/*
+    Appends one decimal word per line to words, skipping blank lines.
+    Returns the 1-based number of the first line that is not a number, or
+    0 if there is none; words is then incomplete.
+*/
+size_t parseInstructions(const string& buffer, vector<ll>& words);
+// applies "pos-val" lines to memory in file order; positions outside size are ignored
+void parseMemory(const string& buffer, ll* memory, size_t size);
+
+#endif
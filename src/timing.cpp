@@ -0,0 +1,25 @@
+#include <vector>
+#include "timing.h"
+#define ll long long
+
+using namespace std;
+
+static Decoded decode(ll instruction) {
+    Decoded d;
+    d.flags = (isNoop(instruction) ? F_NOOP : 0) | (isLoad(instruction) ? F_LOAD : 0)
+            | (isLUI(instruction) ? F_LUI : 0) | (isBranch(instruction) ? F_BRANCH : 0)
+            | (isJump(instruction) || isJAL(instruction) ? F_JUMP : 0) | (isJR(instruction) ? F_JR : 0);
+    d.write = getWriteReg(instruction);
+    vector<ll> reads = getReadReg(instruction);
+    d.readCount = reads.size();
+    for(size_t i = 0; i < reads.size(); i++)
+        d.reads[i] = reads[i];
+    return d;
+}
+
+vector<Decoded> decodeProgram(const InstructionMemory& IMEM) {
+    vector<Decoded> decoded(IMEM.imem.size() + 1);
+    for(size_t i = 0; i < IMEM.imem.size(); i++)
+        decoded[i] = decode(IMEM.imem[i]);
+    return decoded;
+}
@@ -0,0 +1,165 @@
+#ifndef TIMING_HEADER
+#define TIMING_HEADER
+
+#include <cstdlib>
+#include <vector>
+#include "instruction.h"
+#include "memory.h"
+#include "simulator.h"
+#define ll long long
+using namespace std;
+
+/*
+    The control of proc_simN without its datapath: load-use and data
+    hazards, branch and jump bubbles and, for proc_sim3, the random load
+    misses, on pre-decoded instructions. Whoever executes the program
+    hands it the index of every instruction in fetch order; the cycle,
+    instruction and stall counts are then exactly those of the pipeline.
+    The decoupled back end (decoupled.h) and the batch engine (batch.h)
+    both replay programs through it.
+*/
+
+enum TimingModel {
+    TIMING_STALL,           // proc_sim1
+    TIMING_FORWARD,         // proc_sim2
+    TIMING_FORWARD_MISS     // proc_sim3
+};
+
+// what the timing needs to know about an instruction
+enum DecodedFlags {F_NOOP = 1, F_LOAD = 2, F_LUI = 4, F_BRANCH = 8, F_JUMP = 16, F_JR = 32};
+
+struct Decoded {
+    unsigned char flags = F_NOOP;
+    signed char write = -1;             // getWriteReg
+    unsigned char readCount = 0;
+    signed char reads[2] = {0, 0};
+};
+
+/*
+    IMEM decoded, followed by the noop that bubbles and fetches outside of
+    instruction memory read as; its index is IMEM.imem.size().
+*/
+vector<Decoded> decodeProgram(const InstructionMemory& IMEM);
+
+// hazardExists on decoded instructions: i1 reads what the older i2 writes
+static inline bool dependsOn(const Decoded& i1, const Decoded& i2) {
+    if((i1.flags | i2.flags) & F_NOOP)
+        return false;
+    for(int i = 0; i < i1.readCount; i++)
+        if(i1.reads[i] == i2.write)
+            return true;
+    return false;
+}
+
+/*
+    The control of the cycle() of proc_simN, split at the fetch:
+    untilFetch() runs cycles until one fetches and fetch() completes that
+    cycle with the instruction. Latches hold indices into decoded.
+*/
+template<TimingModel model>
+class Timing {
+public:
+    Timing(const vector<Decoded>& decoded, unsigned seed)
+            : decoded(&decoded), seed(seed) {
+        ifid = idex = exmem = memwb = bubble();
+    }
+
+    // false once all latches hold noops, the end of the program
+    bool untilFetch() {
+        while(!stop) {
+            if constexpr (model == TIMING_FORWARD_MISS) {
+                if(is(exmem, F_LOAD)) {
+                    if(!loadStall) {
+                        double random = rand_r(&seed) / (RAND_MAX + 0.0);
+                        if(random >= PROC_SIM3_X) {
+                            loadStall = true;
+                            loadDelay = 1;
+                        }
+                    }
+                    else {
+                        loadDelay++;
+                        if(loadDelay > PROC_SIM3_N - 1) {
+                            loadStall = false;
+                            loadDelay = 0;
+                        }
+                    }
+                }
+            }
+
+            if(!loadStall) {
+                bool branchStall = is(ifid, F_BRANCH) || is(idex, F_BRANCH);
+                bool hazard;
+                if constexpr (model == TIMING_STALL)
+                    hazard = dependsOn(at(ifid), at(exmem)) || dependsOn(at(ifid), at(idex));
+                else
+                    hazard = is(idex, F_LOAD | F_LUI) && dependsOn(at(ifid), at(idex));
+                bool jump = is(ifid, F_JUMP | F_JR);
+
+                memwb = exmem;
+                exmem = idex;
+                if(!hazard)
+                    idex = ifid;
+                else {
+                    c.hazardStalls++;
+                    idex = bubble();
+                }
+
+                if(!branchStall) {
+                    if(!hazard) {
+                        if(!jump)
+                            return true;
+                        ifid = bubble();
+                        c.jumpStalls++;
+                    }
+                }
+                else if(!hazard) {
+                    c.branchStalls++;
+                    ifid = bubble();
+                }
+                stop = is(ifid, F_NOOP) && is(idex, F_NOOP) && is(exmem, F_NOOP) && is(memwb, F_NOOP);
+            }
+            endCycle();
+        }
+        return false;
+    }
+
+    void fetch(unsigned index) {
+        ifid = index;
+        stop = is(ifid, F_NOOP) && is(idex, F_NOOP) && is(exmem, F_NOOP) && is(memwb, F_NOOP);
+        endCycle();
+    }
+
+    // whether both will time the same instructions the same from here on
+    bool sameState(const Timing& other) const {
+        return ifid == other.ifid && idex == other.idex && exmem == other.exmem && memwb == other.memwb
+                && loadStall == other.loadStall && loadDelay == other.loadDelay && seed == other.seed
+                && stop == other.stop;
+    }
+
+    Counters c = {0, 0, 0, 0, 0, 0};
+
+private:
+    inline unsigned bubble() const {
+        return decoded->size() - 1;
+    }
+    inline const Decoded& at(unsigned index) const {
+        return (*decoded)[index];
+    }
+    inline bool is(unsigned index, int flags) const {
+        return (at(index).flags & flags) != 0;
+    }
+    inline void endCycle() {
+        c.cycles++;
+        c.instructions += !is(memwb, F_NOOP) && !loadStall;
+        c.loadStalls += loadStall;
+    }
+
+    const vector<Decoded>* decoded;
+    unsigned ifid, idex, exmem, memwb;
+    bool stop = false;
+    bool loadStall = false;
+    int loadDelay = 0;
+    unsigned seed;
+};
+
+#endif
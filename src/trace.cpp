@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <iostream>
+#include "instruction.h"
+#include "trace.h"
+#define ll long long
+
+using namespace std;
+
+#define TRACE_RING_RECORDS (1 << 16)
+
+static const char* stageNames[] = {"F", "D", "X", "M", "W"};
+static const char* stallNames[] = {"hazard", "branch", "jump", "load miss"};
+
+PipelineTrace::PipelineTrace(string file) : ring(file == "" ? 1 : TRACE_RING_RECORDS) {
+    if(file == "")
+        return;
+    enabled = true;
+    writerThread = thread(&PipelineTrace::writer, this, file);
+}
+
+PipelineTrace::~PipelineTrace() {
+    if(writerThread.joinable()) {
+        done.store(true, memory_order_release);
+        writerThread.join();
+    }
+}
+
+void PipelineTrace::watchStalls(const ll* hazard, const ll* branch, const ll* jump, const ll* loadMiss) {
+    counters[STALL_HAZARD] = hazard;
+    counters[STALL_BRANCH] = branch;
+    counters[STALL_JUMP] = jump;
+    counters[STALL_LOAD_MISS] = loadMiss;
+}
+
+ll PipelineTrace::changed(int index) {
+    if(counters[index] == nullptr)
+        return 0;
+    ll delta = *counters[index] - seen[index];
+    seen[index] = *counters[index];
+    return delta;
+}
+
+void PipelineTrace::stall(ll cycle, ll id, StallCause cause) {
+    if(id >= 0)
+        ring.push({TraceRecord::STALL, cause, cycle, id, 0, 0});
+}
+
+void PipelineTrace::cycle(ll cycle, ll ifidPC, ll ifidInstruction) {
+    bool hazard = changed(STALL_HAZARD) > 0;
+    bool branch = changed(STALL_BRANCH) > 0;
+    bool jump = changed(STALL_JUMP) > 0;
+    if(changed(STALL_LOAD_MISS) > 0) {
+        // nothing moved; the load in EXMEM is waiting for memory
+        stall(cycle, slot[2], STALL_LOAD_MISS);
+        return;
+    }
+
+    ll retiring = slot[3];
+    ll jumping = slot[0];   // a jump leaving IFID caused the bubble behind it
+    slot[3] = slot[2];
+    slot[2] = slot[1];
+    if(hazard)
+        slot[1] = -1;
+    else {
+        slot[1] = slot[0];
+        slot[0] = -1;
+        if(!isNoop(ifidInstruction)) {
+            slot[0] = nextId++;
+            if(isBranch(ifidInstruction))
+                lastBranch = slot[0];
+            // fetched during this cycle, so it is already in D at its end
+            ring.push({TraceRecord::FETCH, 0, cycle - 1, slot[0], ifidPC, ifidInstruction});
+        }
+    }
+
+    if(retiring >= 0)
+        ring.push({TraceRecord::RETIRE, 0, cycle, retiring, 0, 0});
+    for(int i = TRACE_LATCHES - 1; i >= 0; i--) {
+        // an instruction held in IFID by a hazard stays in D
+        if(slot[i] >= 0 && !(i == 0 && hazard))
+            ring.push({TraceRecord::STAGE, i + 1, cycle, slot[i], 0, 0});
+    }
+    if(hazard)
+        stall(cycle, slot[0], STALL_HAZARD);
+    if(jump)
+        stall(cycle, jumping, STALL_JUMP);
+    if(branch)
+        stall(cycle, lastBranch, STALL_BRANCH);
+}
+
+void PipelineTrace::finish(ll cycle) {
+    if(!enabled)
+        return;
+    // whatever is still in the pipeline leaves it at the last cycle
+    for(int i = 0; i < TRACE_LATCHES; i++) {
+        if(slot[i] >= 0)
+            ring.push({TraceRecord::RETIRE, 0, cycle, slot[i], 0, 0});
+        slot[i] = -1;
+    }
+    done.store(true, memory_order_release);
+    writerThread.join();
+}
+
+static string label(ll pc, ll instruction) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%lld: %s (%08llx)", pc, mnemonic(instruction).c_str(), instruction);
+    return buffer;
+}
+
+void PipelineTrace::writer(string file) {
+    FILE* out = fopen(file.c_str(), "w");
+    if(out == nullptr) {
+        cerr << "cannot write pipeline trace to " << file << endl;
+        // keep draining so the simulation never blocks on a full buffer
+    }
+    else {
+        setvbuf(out, nullptr, _IOFBF, 1 << 20);
+        fprintf(out, "Kanata\t0004\nC=\t0\n");
+    }
+
+    ll current = 0, retired = 0;
+    TraceRecord r;
+    while(true) {
+        if(!ring.tryPop(r)) {
+            if(done.load(memory_order_acquire) && ring.empty())
+                break;
+            this_thread::yield();
+            continue;
+        }
+        if(out == nullptr)
+            continue;
+        if(r.cycle > current) {
+            fprintf(out, "C\t%lld\n", r.cycle - current);
+            current = r.cycle;
+        }
+        switch(r.kind) {
+        case TraceRecord::FETCH:
+            fprintf(out, "I\t%lld\t%lld\t0\nL\t%lld\t0\t%s\nS\t%lld\t0\t%s\n", r.id, r.id,
+                    r.id, label(r.pc, r.instruction).c_str(), r.id, stageNames[0]);
+            break;
+        case TraceRecord::STAGE:
+            fprintf(out, "S\t%lld\t0\t%s\n", r.id, stageNames[r.value]);
+            break;
+        case TraceRecord::RETIRE:
+            fprintf(out, "R\t%lld\t%lld\t0\n", r.id, retired++);
+            break;
+        case TraceRecord::STALL:
+            fprintf(out, "L\t%lld\t1\tstall(%s)@%lld \n", r.id, stallNames[r.value], r.cycle);
+            break;
+        }
+    }
+    if(out != nullptr)
+        fclose(out);
+}
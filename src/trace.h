@@ -0,0 +1,76 @@
+#ifndef TRACE_HEADER
+#define TRACE_HEADER
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include "ring.h"
+#define ll long long
+using namespace std;
+
+/*
+    Per-instruction pipeline trace in the Kanata format read by the Konata
+    pipeline viewer. The simulation thread only tracks which instruction
+    sits in which latch and pushes small records into a ring buffer; a
+    background thread formats and writes them.
+
+    An instruction is in F the cycle it is fetched and in D, X, M, W while
+    it sits in IFID, IDEX, EXMEM and MEMWB. Stalls are attached to the
+    instruction responsible as hover labels. These pipelines never fetch
+    down a wrong path, so no instruction is ever flushed.
+*/
+
+enum StallCause {STALL_HAZARD, STALL_BRANCH, STALL_JUMP, STALL_LOAD_MISS};
+
+struct TraceRecord {
+    enum Kind {FETCH, STAGE, RETIRE, STALL};
+    int kind;
+    int value;      // stage index or stall cause
+    ll cycle;
+    ll id;
+    ll pc;
+    ll instruction;
+};
+
+#define TRACE_LATCHES 4     // IFID, IDEX, EXMEM, MEMWB
+
+class PipelineTrace {
+public:
+    // no file disables tracing; cycle() must then not be called
+    PipelineTrace(string file = "");
+    ~PipelineTrace();
+    PipelineTrace(const PipelineTrace&) = delete;
+    PipelineTrace& operator=(const PipelineTrace&) = delete;
+
+    /*
+        The stall counters of the simulator; the trace compares them between
+        cycles to tell what happened. hazard is the cause name used for
+        hazard bubbles. Any pointer may be null.
+    */
+    void watchStalls(const ll* hazard, const ll* branch, const ll* jump, const ll* loadMiss);
+
+    // call after the latches were updated at the end of cycle
+    void cycle(ll cycle, ll ifidPC, ll ifidInstruction);
+
+    // drains the buffer and closes the file
+    void finish(ll cycle);
+
+    bool enabled = false;
+
+private:
+    void writer(string file);
+    void stall(ll cycle, ll id, StallCause cause);
+    ll changed(int index);
+
+    RingBuffer<TraceRecord> ring;
+    thread writerThread;
+    atomic<bool> done{false};
+
+    ll slot[TRACE_LATCHES] = {-1, -1, -1, -1};  // id in each latch, -1 for a bubble
+    ll nextId = 0;
+    ll lastBranch = -1;
+    const ll* counters[4] = {nullptr, nullptr, nullptr, nullptr};
+    ll seen[4] = {0, 0, 0, 0};
+};
+
+#endif
@@ -9,7 +9,7 @@ BIN_LOCATIONS = ["../bin/proc_sim1", "../bin/proc_sim2", "../bin/proc_sim3"]
 #BIN_LOCATIONS = ["../bin/proc_sim2"]
 RF_SIZE = 32
 MEM_SIZE = 10000
-TEST_CASE_GEN_LOC = "TestGenerator"
+TEST_CASE_GEN_LOC = "../bin/assembler"
 TEST_CASE_LOC = "test_case"
 
 
@@ -17,8 +17,8 @@ TEST_CASE_LOC = "test_case"
 def gen_test_case(folder):
     src = folder + "/src"
 
-    #Generating the test_case using the TestGenerator in obj folder
-    cmd = "java {} {} {}".format(TEST_CASE_GEN_LOC, src, TEST_CASE_LOC)
+    #Generating the test_case using the assembler in bin folder
+    cmd = "{} {} {}".format(TEST_CASE_GEN_LOC, src, TEST_CASE_LOC)
     prog = subprocess.Popen(cmd, shell = True)
     prog.wait()
 
@@ -103,7 +103,13 @@ if __name__ == "__main__":
     test_cases_hard = ["hard/array_sum"]
     #test_cases_hard = ["hard/array_sum", "hard/sel_sort"]
 
-    test_cases = test_cases_basic + test_cases_hard
+    # written by ./generate.py all; found the way test_runner finds them, so
+    # the two drivers run the same workloads
+    test_cases_gen = ["gen/" + name for name in sorted(os.listdir("gen"))
+                if all(os.path.isfile(os.path.join("gen", name, f)) for f in ("src", "mem", "res"))] \
+            if os.path.isdir("gen") else []
+
+    test_cases = test_cases_basic + test_cases_hard + test_cases_gen
 
     for test_case in test_cases:
         for bin in BIN_LOCATIONS:    
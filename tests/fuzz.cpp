@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "assembler.h"
+#include "batch.h"
+#include "decoupled.h"
+#include "interval.h"
+#include "memory.h"
+#include "number.h"
+#include "reference.h"
+#include "simulator.h"
+#define ll long long
+using namespace std;
+
+/*
+    Differential fuzzer:
+
+        fuzz [--programs=N] [--seed=S] [--threads=N] [--out=DIR]
+
+    Generates N random programs from seeds S, S+1, ..., runs each on the
+    functional model in reference.h and on proc_sim1..3, and compares the
+    final registers, memory and instruction count, and the cycle count with
+    the decoupled run and an interval run (interval.h, intervals of
+    INTERVAL instructions) of the same simulator. A batch run (batch.h)
+    of BATCH instances on memories that differ, so that their branches go
+    apart, has to end every instance as a run of the simulator on its
+    memory would, and a run with MSHRS non-blocking loads (--mshrs) as the
+    model does, in no more cycles than the pipeline. Programs are valid by
+    construction: loops are bounded by a counter, branches go forward,
+    calls go to leaf functions and loads and stores use a fixed base with
+    small offsets, so every address is inside a 32-word window.
+
+    A mismatch is minimized by removing instructions for as long as the
+    same simulator still disagrees with the model, and the smallest program
+    is written in the tests/ layout to DIR/<seed>_proc_simN (src, mem and
+    the res of the model), where checker.py and test_runner can replay it.
+    The exit status is 1 if anything was found.
+*/
+
+#define MAX_CYCLES 1000000
+#define WINDOW 16   // words reachable from each base register
+#define INTERVAL 16
+#define BATCH 6     // instances of a batch run
+#define MSHRS 2
+
+static const Pipeline pipelines[] = {runProcSim1, runProcSim2, runProcSim3};
+static const Pipeline decoupledPipelines[] = {runDecoupledProcSim1, runDecoupledProcSim2, runDecoupledProcSim3};
+static const Pipeline intervalPipelines[] = {runIntervalsProcSim1, runIntervalsProcSim2, runIntervalsProcSim3};
+static const BatchPipeline batchPipelines[] = {runBatchProcSim1, runBatchProcSim2, runBatchProcSim3};
+
+// one line of a generated program; branch and jump targets stay symbolic
+// so that lines can be removed while minimizing
+struct Line {
+    string text;        // without the target
+    int target = -1;    // label a branch or jump refers to
+    int label = -1;     // label defined before this line, if text is empty
+};
+
+struct FuzzProgram {
+    vector<Line> lines;
+    vector<pair<int, ll>> memory;   // initial words
+};
+
+static const char* pool[] = {"$v0", "$v1", "$a0", "$a1", "$a2", "$a3", "$t0", "$t1", "$t2",
+                             "$t3", "$t4", "$t5", "$t6", "$t7", "$s0", "$s1", "$s2", "$s3"};
+
+/*
+    Reserved registers: $s5 holds 1, $s6 counts loop iterations, $s7 is the
+    second base address and $ra is only written by jal.
+*/
+class Generator {
+public:
+    Generator(ll seed) : random(seed) {
+        int n = 3 + random() % 6;
+        vector<string> all(pool, pool + sizeof(pool) / sizeof(pool[0]));
+        shuffle(all.begin(), all.end(), random);
+        regs.assign(all.begin(), all.begin() + n);
+    }
+
+    FuzzProgram generate() {
+        FuzzProgram p;
+        for(int i = 0; i < 2 * WINDOW; i++)
+            if(random() % 2)
+                p.memory.push_back({i < WINDOW ? i : 1000 + i - WINDOW, (ll) (random() % 2000) - 1000});
+        out = &p.lines;
+        emit("lui $s5 1");
+        emit("srl $s5 $s5 16");
+        emit("lui $s7 4000");
+        emit("srl $s7 $s7 16");
+        for(string& r : regs)
+            if(random() % 2)
+                emit("lui " + r + " " + to_string(random() % 65536));
+
+        int blocks = 4 + random() % 12, functions = 1 + random() % 3;
+        int end = newLabel(), first = labels;
+        labels += functions;
+        for(int b = 0; b < blocks; b++) {
+            switch(random() % 6) {
+            case 0: case 1: straight(1 + random() % 6); break;
+            case 2: branch(); break;
+            case 3: loop(); break;
+            case 4: jump(first + random() % functions); break;
+            default: straight(1 + random() % 3); break;
+            }
+        }
+        jump(end, "j");
+        for(int f = 0; f < functions; f++) {
+            label(first + f);
+            straight(1 + random() % 4);
+            if(random() % 2)
+                branch();
+            emit("jr $ra");
+        }
+        label(end);
+        return p;
+    }
+
+private:
+    void emit(string text, int target = -1) {
+        Line l;
+        l.text = text;
+        l.target = target;
+        out->push_back(l);
+    }
+
+    void label(int id) {
+        Line l;
+        l.label = id;
+        out->push_back(l);
+    }
+
+    int newLabel() {
+        return labels++;
+    }
+
+    void jump(int target, string op = "jal") {
+        emit(op, target);
+    }
+
+    string reg() {
+        return regs[random() % regs.size()];
+    }
+
+    string source() {
+        int r = random() % 8;
+        return r == 0 ? "$zero" : r == 1 ? "$s5" : reg();
+    }
+
+    void straight(int n) {
+        static const char* ops[] = {"add", "sub", "and", "or", "slt"};
+        for(int i = 0; i < n; i++) {
+            string base = random() % 2 ? "$zero" : "$s7";
+            string offset = to_string(4 * (random() % WINDOW));
+            switch(random() % 9) {
+            case 0: case 1: case 2:
+                emit(string(ops[random() % 5]) + " " + reg() + " " + source() + " " + source());
+                break;
+            case 3: emit("sll " + reg() + " " + source() + " " + to_string(random() % 4)); break;
+            case 4: emit("srl " + reg() + " " + source() + " " + to_string(random() % 32)); break;
+            case 5: emit("lui " + reg() + " " + to_string(random() % 65536)); break;
+            case 6: case 7: emit("lw " + reg() + " " + offset + "(" + base + ")"); break;
+            default: emit("sw " + source() + " " + offset + "(" + base + ")"); break;
+            }
+        }
+    }
+
+    void branch() {
+        int skip = newLabel();
+        emit(string(random() % 2 ? "beq" : "bne") + " " + source() + " " + source(), skip);
+        straight(1 + random() % 3);
+        label(skip);
+    }
+
+    void loop() {
+        int top = newLabel(), exit = newLabel();
+        emit("lui $s6 " + to_string(1 + random() % 4));
+        emit("srl $s6 $s6 16");
+        label(top);
+        emit("beq $s6 $zero", exit);
+        straight(1 + random() % 4);
+        if(random() % 2)
+            branch();
+        emit("sub $s6 $s6 $s5");
+        emit("j", top);
+        label(exit);
+    }
+
+    mt19937_64 random;
+    vector<string> regs;
+    vector<Line>* out = nullptr;
+    int labels = 0;
+};
+
+// the program as TestGenerator source, with targets resolved
+static string source(const vector<Line>& lines) {
+    vector<int> address;
+    int count = 0;
+    for(const Line& l : lines) {
+        if(l.text == "") {
+            if((int) address.size() <= l.label)
+                address.resize(l.label + 1, -1);
+            address[l.label] = count;
+        }
+        else
+            count++;
+    }
+    string text;
+    int index = 0;
+    for(const Line& l : lines) {
+        if(l.text == "")
+            continue;
+        text += l.text;
+        if(l.target >= 0) {
+            int target = l.target < (int) address.size() ? address[l.target] : -1;
+            if(target < 0)
+                target = count;     // the label was removed; go to the end
+            bool jump = l.text == "j" || l.text == "jal";
+            text += " " + to_string(jump ? target : max(0, target - index - 1));
+        }
+        text += "\n";
+        index++;
+    }
+    return text;
+}
+
+struct Outcome {
+    SimResult result;
+    vector<ll> memory;
+};
+
+// instances of a batch from 2 on get few distinct words, so that branches
+// on them go apart; instances come in pairs that are alike
+static void initialMemory(Memory& MEM, const FuzzProgram& p, int instance = 0) {
+    for(const pair<int, ll>& w : p.memory)
+        MEM.store(w.first, instance < 2 ? w.second : w.second % (instance / 2 + 1));
+}
+
+static Outcome reference(const vector<ll>& words, const FuzzProgram& p) {
+    InstructionMemory IMEM(words);
+    Memory MEM("/dev/null");
+    initialMemory(MEM, p);
+    Outcome o;
+    o.result = runReference(IMEM, MEM, MAX_CYCLES);
+    o.memory.assign(MEM.memory, MEM.memory + MEM.size);
+    return o;
+}
+
+// empty if the pipeline agrees with the model, else what differs
+static string compare(int variant, const vector<ll>& words, const FuzzProgram& p, const Outcome& expected) {
+    Options options;
+    options.maxCycles = 20 * MAX_CYCLES;
+    options.seed = 1;
+    HostPerf perf(false);
+    InstructionMemory IMEM(words);
+    Memory MEM("/dev/null");
+    initialMemory(MEM, p);
+    SimResult r = pipelines[variant](options, IMEM, MEM, perf);
+    if(!r.finished)
+        return "did not finish";
+    for(int i = 0; i < 32; i++)
+        if(r.rf[i] != expected.result.rf[i])
+            return "register " + to_string(i) + " is " + to_string(r.rf[i]) + ", expected "
+                    + to_string(expected.result.rf[i]);
+    for(size_t i = 0; i < MEM.size; i++)
+        if(MEM.memory[i] != expected.memory[i])
+            return "memory word " + to_string(i) + " is " + to_string(MEM.memory[i]) + ", expected "
+                    + to_string(expected.memory[i]);
+    if(r.instructions != expected.result.instructions)
+        return to_string(r.instructions) + " instructions, expected " + to_string(expected.result.instructions);
+
+    // the decoupled run has to take exactly the pipeline's cycles
+    options.maxCycles = 0;
+    Memory DMEM("/dev/null");
+    initialMemory(DMEM, p);
+    SimResult d = decoupledPipelines[variant](options, IMEM, DMEM, perf);
+    if(d.cycles != r.cycles || d.instructions != r.instructions)
+        return "decoupled run took " + to_string(d.cycles) + " cycles for " + to_string(d.instructions)
+                + " instructions, the pipeline " + to_string(r.cycles) + " for " + to_string(r.instructions);
+
+    // and so does the sum of the intervals after their warm-up
+    options.interval = INTERVAL;
+    options.threads = 1;    // the programs already run in parallel
+    Memory VMEM("/dev/null");
+    initialMemory(VMEM, p);
+    SimResult v = intervalPipelines[variant](options, IMEM, VMEM, perf);
+    if(v.cycles != r.cycles || v.instructions != r.instructions)
+        return "interval run took " + to_string(v.cycles) + " cycles for " + to_string(v.instructions)
+                + " instructions, the pipeline " + to_string(r.cycles) + " for " + to_string(r.instructions);
+
+    // and every instance of a batch whose branches go apart ends as its own run
+    options.interval = 0;
+    vector<unique_ptr<Memory>> memories;
+    vector<Memory*> BMEM;
+    for(int i = 0; i < BATCH; i++) {
+        memories.push_back(make_unique<Memory>("/dev/null"));
+        initialMemory(*memories.back(), p, i);
+        BMEM.push_back(memories.back().get());
+    }
+    vector<SimResult> b = batchPipelines[variant](options, IMEM, BMEM, perf, nullptr);
+    for(int i = 0; i < BATCH; i++) {
+        Memory SMEM("/dev/null");
+        initialMemory(SMEM, p, i);
+        SimResult s = pipelines[variant](options, IMEM, SMEM, perf);
+        string at = "batch instance " + to_string(i);
+        if(b[i].cycles != s.cycles || b[i].instructions != s.instructions)
+            return at + " took " + to_string(b[i].cycles) + " cycles for " + to_string(b[i].instructions)
+                    + " instructions, its pipeline " + to_string(s.cycles) + " for " + to_string(s.instructions);
+        if(b[i].rf != s.rf)
+            return at + " ended with other registers than its pipeline";
+        for(size_t w = 0; w < SMEM.size; w++)
+            if(BMEM[i]->memory[w] != SMEM.memory[w])
+                return at + " has memory word " + to_string(w) + " " + to_string(BMEM[i]->memory[w])
+                        + ", its pipeline " + to_string(SMEM.memory[w]);
+    }
+
+    // non-blocking loads only ever save cycles
+    options.mshrs = MSHRS;
+    Memory NMEM("/dev/null");
+    initialMemory(NMEM, p);
+    SimResult n = pipelines[variant](options, IMEM, NMEM, perf);
+    if(n.rf != expected.result.rf)
+        return "non-blocking run ended with other registers than the model";
+    for(size_t i = 0; i < NMEM.size; i++)
+        if(NMEM.memory[i] != expected.memory[i])
+            return "non-blocking run has memory word " + to_string(i) + " " + to_string(NMEM.memory[i])
+                    + ", expected " + to_string(expected.memory[i]);
+    if(n.cycles > r.cycles || n.instructions != r.instructions)
+        return "non-blocking run took " + to_string(n.cycles) + " cycles for " + to_string(n.instructions)
+                + " instructions, the pipeline " + to_string(r.cycles) + " for " + to_string(r.instructions);
+    return "";
+}
+
+// whether lines still make variant disagree with a model run that finishes
+static bool fails(int variant, const FuzzProgram& p, string* detail = nullptr) {
+    vector<ll> words;
+    string error;
+    if(!assemble(source(p.lines), words, error))
+        return false;
+    Outcome expected = reference(words, p);
+    if(!expected.result.finished)
+        return false;
+    string d = compare(variant, words, p, expected);
+    if(detail != nullptr)
+        *detail = d;
+    return d != "";
+}
+
+// removes chunks of lines, halving the chunk size whenever nothing can go
+static FuzzProgram minimize(int variant, FuzzProgram p) {
+    for(size_t chunk = max((size_t) 1, p.lines.size() / 2); chunk >= 1; chunk /= 2) {
+        for(size_t start = 0; start < p.lines.size(); ) {
+            FuzzProgram candidate = p;
+            size_t end = min(start + chunk, candidate.lines.size());
+            candidate.lines.erase(candidate.lines.begin() + start, candidate.lines.begin() + end);
+            if(fails(variant, candidate))
+                p = candidate;
+            else
+                start += chunk;
+        }
+        for(size_t i = 0; i < p.memory.size(); ) {
+            FuzzProgram candidate = p;
+            candidate.memory.erase(candidate.memory.begin() + i);
+            if(fails(variant, candidate))
+                p = candidate;
+            else
+                i++;
+        }
+        if(chunk == 1)
+            break;
+    }
+    return p;
+}
+
+static void writeCase(const string& dir, const FuzzProgram& p) {
+    mkdir(dir.c_str(), 0755);
+    string text = source(p.lines);
+    ofstream(dir + "/src") << text;
+    ofstream mem (dir + "/mem");
+    for(const pair<int, ll>& w : p.memory)
+        mem << w.first << "-" << w.second << "\n";
+
+    vector<ll> words;
+    string error;
+    assemble(text, words, error);
+    Outcome expected = reference(words, p);
+    ofstream res (dir + "/res");
+    res << "Register file: \n";
+    for(int i = 0; i < 32; i++)
+        res << expected.result.rf[i] << (i % 8 == 7 ? " \n" : " ");
+    res << "\nMemory: \n";
+    for(size_t i = 0; i < MEMORY_SIZE; i++)
+        res << expected.memory[i] << (i % 5000 == 4999 ? " \n" : " ");
+}
+
+static void usage(const char* name) {
+    cerr << "usage: " << name << " [--programs=N] [--seed=S] [--threads=N] [--out=DIR]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    ll programs = 1000, seed = 1;
+    int threads = max(1u, thread::hardware_concurrency());
+    string outDir = "fuzz-failures";
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool ok = true;
+        if(arg.compare(0, 11, "--programs=") == 0)
+            ok = number(arg.substr(11), programs);
+        else if(arg.compare(0, 7, "--seed=") == 0)
+            ok = number(arg.substr(7), seed);
+        else if(arg.compare(0, 10, "--threads=") == 0) {
+            ok = number(arg.substr(10), threads);
+            threads = max(1, threads);
+        }
+        else if(arg.compare(0, 6, "--out=") == 0)
+            outDir = arg.substr(6);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+        if(!ok) {
+            cerr << "not a number in range in " << arg << endl;
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    atomic<ll> next(0), found(0), instructions(0);
+    mutex printing;
+    auto worker = [&]() {
+        for(ll i; (i = next++) < programs; ) {
+            FuzzProgram p = Generator(seed + i).generate();
+            vector<ll> words;
+            string error;
+            if(!assemble(source(p.lines), words, error)) {
+                lock_guard<mutex> lock(printing);
+                cerr << "seed " << seed + i << ": generated an invalid program, " << error << endl;
+                found++;
+                continue;
+            }
+            Outcome expected = reference(words, p);
+            instructions += expected.result.instructions;
+            for(int variant = 0; variant < 3; variant++) {
+                string detail = compare(variant, words, p, expected);
+                if(detail == "")
+                    continue;
+                FuzzProgram small = minimize(variant, p);
+                fails(variant, small, &detail);
+                string dir = outDir + "/" + to_string(seed + i) + "_proc_sim" + to_string(variant + 1);
+                {
+                    lock_guard<mutex> lock(printing);
+                    mkdir(outDir.c_str(), 0755);
+                    writeCase(dir, small);
+                    printf("seed %lld, proc_sim%d: %s\n    minimized to %zu lines in %s\n", seed + i,
+                           variant + 1, detail.c_str(), small.lines.size(), dir.c_str());
+                }
+                found++;
+            }
+        }
+    };
+    vector<thread> pool;
+    for(int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for(thread& t : pool)
+        t.join();
+
+    printf("%lld programs (%lld instructions) on %d threads, %lld mismatches\n",
+           programs, (ll) instructions, threads, (ll) found);
+    return found ? 1 : 0;
+}
@@ -0,0 +1,475 @@
+#!/usr/bin/env python3
+
+"""
+Generates parameterised kernels in the tests/ layout (src, mem, res):
+
+    ./generate.py KERNEL [--size N] [--seed S] [--out DIR]
+    ./generate.py all [--seed S]
+
+KERNEL is one of matmul, memcpy, list, bsearch, histogram, bubble_sort,
+selection_sort, crc32 or unrolled_sum. --size scales the input (elements,
+matrix dimension or bytes); the dynamic instruction count grows linearly
+with it for memcpy, list, histogram, crc32 and unrolled_sum, as n log n
+for bsearch and quadratically or cubically for the sorts and matmul, so a
+few thousand elements are enough for millions of instructions. DIR
+defaults to gen/KERNEL_N. "all" writes every kernel at its default size to
+gen/, the cases checker.py runs.
+
+The expected res is not produced by running a simulator: the final memory
+is computed here with plain Python (sorted(), zlib.crc32, ...), and every
+kernel ends by clearing the registers it used except $v0, which holds a
+result that is also computed here. A mistake in the generated assembly
+therefore shows up as a failure rather than as a wrong expectation.
+
+The ISA has no immediates other than lui and only forward branches, so
+constants are built with lui/srl/or and loops close with j. The emitter
+resolves labels to the numeric targets TestGenerator expects.
+"""
+
+import argparse
+import os
+import random
+import zlib
+
+RF_SIZE = 32
+MEM_SIZE = 100000
+
+REGISTERS = ["$zero", "$at", "$v0", "$v1", "$a0", "$a1", "$a2", "$a3",
+             "$t0", "$t1", "$t2", "$t3", "$t4", "$t5", "$t6", "$t7",
+             "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+             "$t8", "$t9", "$k0", "$k1", "$gp", "$sp", "$fp", "$ra"]
+
+
+
+class Program:
+    def __init__(self):
+        self.lines = []
+        self.labels = {}
+        self.used = set()
+
+    def label(self, name):
+        self.labels[name] = len(self.lines)
+
+    def emit(self, op, *args):
+        for arg in args:
+            arg = str(arg)
+            if "$" in arg:
+                self.used.add("$" + arg.split("$")[1].rstrip(")"))
+        self.lines.append([op] + [str(arg) for arg in args])
+
+    def li(self, reg, value):
+        # lui puts the immediate in the upper half, srl brings it down
+        if value < (1 << 16):
+            self.emit("lui", reg, value)
+            self.emit("srl", reg, reg, 16)
+        else:
+            self.emit("lui", reg, value >> 16)
+            self.emit("lui", "$at", value & 0xffff)
+            self.emit("srl", "$at", "$at", 16)
+            self.emit("or", reg, reg, "$at")
+
+    def xor(self, rd, rs, rt, t1, t2):
+        # a ^ b == (a | b) - (a & b)
+        self.emit("or", t1, rs, rt)
+        self.emit("and", t2, rs, rt)
+        self.emit("sub", rd, t1, t2)
+
+    def epilogue(self, keep = ("$v0",)):
+        self.label("end")
+        for reg in sorted(self.used, key = REGISTERS.index):
+            if reg != "$zero" and reg not in keep:
+                self.emit("add", reg, "$zero", "$zero")
+
+    def source(self):
+        out = []
+        for i, line in enumerate(self.lines):
+            op, args = line[0], line[1:]
+            if op in ("j", "jal") and args[0] in self.labels:
+                args = [self.labels[args[0]]]
+            elif op in ("beq", "bne") and args[2] in self.labels:
+                offset = self.labels[args[2]] - (i + 1)
+                assert offset >= 0, "branches only go forward"
+                args = args[:2] + [offset]
+            out.append(" ".join([op] + [str(arg) for arg in args]))
+        return "\n".join(out)
+
+
+
+def constants(p):
+    p.li("$s0", 1)
+    p.li("$s1", 4)
+
+
+def memcpy(n, rng):
+    memory = [rng.randint(0, 1000) for _ in range(n)]
+    p = Program()
+    constants(p)
+    p.li("$a0", n)
+    p.li("$t2", 4 * n)
+    p.label("loop")
+    p.emit("beq", "$t0", "$a0", "done")
+    p.emit("lw", "$t3", "0($t1)")
+    p.emit("sw", "$t3", "0($t2)")
+    p.emit("add", "$t1", "$t1", "$s1")
+    p.emit("add", "$t2", "$t2", "$s1")
+    p.emit("add", "$t0", "$t0", "$s0")
+    p.emit("j", "loop")
+    p.label("done")
+    p.emit("add", "$v0", "$t0", "$zero")
+    p.epilogue()
+    return p, memory, memory + memory, n
+
+
+def matmul(n, rng):
+    a = [rng.randint(0, 15) for _ in range(n * n)]
+    b = [rng.randint(0, 15) for _ in range(n * n)]
+    c = [sum(a[i * n + k] * b[k * n + j] for k in range(n)) for i in range(n) for j in range(n)]
+
+    p = Program()
+    constants(p)
+    p.li("$a0", n)
+    p.li("$a1", 4 * n)              # row stride in bytes
+    p.li("$a2", 4 * n * n)          # B
+    p.li("$t2", 8 * n * n)          # C[i][j]
+    p.label("row")
+    p.emit("beq", "$t0", "$a0", "done")
+    p.emit("add", "$t3", "$zero", "$zero")
+    p.emit("add", "$t4", "$a2", "$zero")
+    p.label("column")
+    p.emit("beq", "$t3", "$a0", "next_row")
+    p.emit("add", "$t5", "$zero", "$zero")
+    p.emit("add", "$t6", "$t1", "$zero")
+    p.emit("add", "$t7", "$t4", "$zero")
+    p.emit("add", "$s2", "$zero", "$zero")
+    p.label("dot")
+    p.emit("beq", "$t5", "$a0", "store")
+    p.emit("lw", "$s3", "0($t6)")
+    p.emit("lw", "$s4", "0($t7)")
+    p.emit("jal", "multiply")
+    p.emit("add", "$s2", "$s2", "$v1")
+    p.emit("add", "$t6", "$t6", "$s1")
+    p.emit("add", "$t7", "$t7", "$a1")
+    p.emit("add", "$t5", "$t5", "$s0")
+    p.emit("j", "dot")
+    p.label("store")
+    p.emit("sw", "$s2", "0($t2)")
+    p.emit("add", "$t2", "$t2", "$s1")
+    p.emit("add", "$t4", "$t4", "$s1")
+    p.emit("add", "$t3", "$t3", "$s0")
+    p.emit("j", "column")
+    p.label("next_row")
+    p.emit("add", "$t1", "$t1", "$a1")
+    p.emit("add", "$t0", "$t0", "$s0")
+    p.emit("j", "row")
+    p.label("done")
+    p.emit("add", "$v0", "$s2", "$zero")
+    p.emit("j", "end")
+
+    # $v1 = $s3 * $s4 by shift and add; clobbers $s3, $s4 and $s5
+    p.label("multiply")
+    p.emit("add", "$v1", "$zero", "$zero")
+    p.label("bit")
+    p.emit("beq", "$s4", "$zero", "product")
+    p.emit("and", "$s5", "$s4", "$s0")
+    p.emit("beq", "$s5", "$zero", "shift")
+    p.emit("add", "$v1", "$v1", "$s3")
+    p.label("shift")
+    p.emit("sll", "$s3", "$s3", 1)
+    p.emit("srl", "$s4", "$s4", 1)
+    p.emit("j", "bit")
+    p.label("product")
+    p.emit("jr", "$ra")
+    p.epilogue()
+    return p, a + b, a + b + c, c[-1]
+
+
+def linked_list(n, rng):
+    # node k is at words 2 + 2k (value) and 3 + 2k (byte address of the next node)
+    order = list(range(n))
+    rng.shuffle(order)
+    values = [rng.randint(0, 1000) for _ in range(n)]
+    memory = [0] * (2 + 2 * n)
+    memory[0] = 4 * (2 + 2 * order[0])
+    for i, node in enumerate(order):
+        memory[2 + 2 * node] = values[node]
+        memory[3 + 2 * node] = 4 * (2 + 2 * order[i + 1]) if i + 1 < n else 0
+    expected = list(memory)
+    expected[1] = sum(values)
+
+    p = Program()
+    p.emit("lw", "$t0", "0($zero)")
+    p.label("next")
+    p.emit("beq", "$t0", "$zero", "done")
+    p.emit("lw", "$t1", "0($t0)")
+    p.emit("add", "$v0", "$v0", "$t1")
+    p.emit("lw", "$t0", "4($t0)")
+    p.emit("j", "next")
+    p.label("done")
+    p.emit("sw", "$v0", "4($zero)")
+    p.epilogue()
+    return p, memory, expected, sum(values)
+
+
+def bsearch(n, rng):
+    # queries alternate between keys in the array and keys between them
+    array = sorted(rng.sample(range(0, 4 * n, 2), n))
+    queries = [rng.choice(array) if i % 2 == 0 else 2 * rng.randint(0, 2 * n) + 1 for i in range(max(1, n // 2))]
+    q = len(queries)
+    position = {k: i for i, k in enumerate(array)}
+    results = [position[k] + 1 if k in position else 0 for k in queries]
+
+    p = Program()
+    constants(p)
+    p.li("$a0", n)
+    p.li("$a1", q)
+    p.li("$t0", 4 * n)
+    p.li("$t1", 4 * (n + q))
+    p.label("query")
+    p.emit("beq", "$t2", "$a1", "done")
+    p.emit("lw", "$t3", "0($t0)")
+    p.emit("add", "$t4", "$zero", "$zero")
+    p.emit("add", "$t5", "$a0", "$zero")
+    p.emit("add", "$t6", "$zero", "$zero")
+    p.label("search")
+    p.emit("beq", "$t4", "$t5", "answer")
+    p.emit("add", "$t7", "$t4", "$t5")
+    p.emit("srl", "$t7", "$t7", 1)
+    p.emit("sll", "$s2", "$t7", 2)
+    p.emit("lw", "$s3", "0($s2)")
+    p.emit("beq", "$s3", "$t3", "found")
+    p.emit("slt", "$s4", "$s3", "$t3")
+    p.emit("beq", "$s4", "$zero", "lower")
+    p.emit("add", "$t4", "$t7", "$s0")
+    p.emit("j", "search")
+    p.label("lower")
+    p.emit("add", "$t5", "$t7", "$zero")
+    p.emit("j", "search")
+    p.label("found")
+    p.emit("add", "$t6", "$t7", "$s0")
+    p.emit("add", "$v0", "$v0", "$s0")
+    p.label("answer")
+    p.emit("sw", "$t6", "0($t1)")
+    p.emit("add", "$t0", "$t0", "$s1")
+    p.emit("add", "$t1", "$t1", "$s1")
+    p.emit("add", "$t2", "$t2", "$s0")
+    p.emit("j", "query")
+    p.label("done")
+    p.epilogue()
+    return p, array + queries, array + queries + results, sum(1 for r in results if r)
+
+
+def histogram(n, rng, bins = 16):
+    data = [rng.randint(0, bins - 1) for _ in range(n)]
+    counts = [data.count(b) for b in range(bins)]
+
+    p = Program()
+    constants(p)
+    p.li("$a0", n)
+    p.li("$a1", 4 * n)
+    p.label("loop")
+    p.emit("beq", "$t1", "$a0", "done")
+    p.emit("lw", "$t2", "0($t0)")
+    p.emit("sll", "$t2", "$t2", 2)
+    p.emit("add", "$t2", "$t2", "$a1")
+    p.emit("lw", "$t3", "0($t2)")
+    p.emit("add", "$t3", "$t3", "$s0")
+    p.emit("sw", "$t3", "0($t2)")
+    p.emit("add", "$t0", "$t0", "$s1")
+    p.emit("add", "$t1", "$t1", "$s0")
+    p.emit("j", "loop")
+    p.label("done")
+    p.emit("add", "$v0", "$t1", "$zero")
+    p.epilogue()
+    return p, data, data + counts, n
+
+
+def bubble_sort(n, rng):
+    data = [rng.randint(0, 1000) for _ in range(n)]
+    inversions = sum(1 for i in range(n) for j in range(i + 1, n) if data[i] > data[j])
+
+    p = Program()
+    constants(p)
+    p.li("$a0", n - 1)
+    p.label("pass")
+    p.emit("beq", "$t0", "$a0", "done")
+    p.emit("add", "$t1", "$zero", "$zero")
+    p.emit("add", "$t2", "$zero", "$zero")
+    p.emit("sub", "$t3", "$a0", "$t0")
+    p.label("compare")
+    p.emit("beq", "$t1", "$t3", "next_pass")
+    p.emit("lw", "$t4", "0($t2)")
+    p.emit("lw", "$t5", "4($t2)")
+    p.emit("slt", "$t6", "$t5", "$t4")
+    p.emit("beq", "$t6", "$zero", "in_order")
+    p.emit("sw", "$t5", "0($t2)")
+    p.emit("sw", "$t4", "4($t2)")
+    p.emit("add", "$v0", "$v0", "$s0")
+    p.label("in_order")
+    p.emit("add", "$t2", "$t2", "$s1")
+    p.emit("add", "$t1", "$t1", "$s0")
+    p.emit("j", "compare")
+    p.label("next_pass")
+    p.emit("add", "$t0", "$t0", "$s0")
+    p.emit("j", "pass")
+    p.label("done")
+    p.epilogue()
+    return p, data, sorted(data), inversions
+
+
+def selection_sort(n, rng):
+    data = [rng.randint(0, 1000) for _ in range(n)]
+
+    p = Program()
+    constants(p)
+    p.li("$a0", n)
+    p.label("outer")
+    p.emit("beq", "$t0", "$a0", "done")
+    p.emit("add", "$t5", "$t2", "$zero")
+    p.emit("lw", "$t4", "0($t2)")
+    p.emit("add", "$t1", "$t0", "$s0")
+    p.emit("add", "$t3", "$t2", "$s1")
+    p.label("inner")
+    p.emit("beq", "$t1", "$a0", "swap")
+    p.emit("lw", "$t6", "0($t3)")
+    p.emit("slt", "$t7", "$t6", "$t4")
+    p.emit("beq", "$t7", "$zero", "not_smaller")
+    p.emit("add", "$t4", "$t6", "$zero")
+    p.emit("add", "$t5", "$t3", "$zero")
+    p.label("not_smaller")
+    p.emit("add", "$t1", "$t1", "$s0")
+    p.emit("add", "$t3", "$t3", "$s1")
+    p.emit("j", "inner")
+    p.label("swap")
+    p.emit("lw", "$s2", "0($t2)")
+    p.emit("sw", "$t4", "0($t2)")
+    p.emit("sw", "$s2", "0($t5)")
+    p.emit("add", "$t0", "$t0", "$s0")
+    p.emit("add", "$t2", "$t2", "$s1")
+    p.emit("j", "outer")
+    p.label("done")
+    p.emit("add", "$v0", "$t0", "$zero")
+    p.epilogue()
+    return p, data, sorted(data), n
+
+
+def crc32(n, rng):
+    # one byte per word, bitwise reflected CRC-32 as zlib computes it
+    data = [rng.randint(0, 255) for _ in range(n)]
+    crc = zlib.crc32(bytes(data))
+
+    p = Program()
+    constants(p)
+    p.li("$s2", 8)
+    p.li("$a0", n)
+    p.li("$a1", 0xEDB88320)
+    p.li("$a2", 0xFFFFFFFF)
+    p.emit("add", "$v0", "$a2", "$zero")
+    p.label("byte")
+    p.emit("beq", "$t1", "$a0", "done")
+    p.emit("lw", "$t2", "0($t0)")
+    p.xor("$v0", "$v0", "$t2", "$t3", "$t4")
+    p.emit("add", "$t5", "$zero", "$zero")
+    p.label("bit")
+    p.emit("beq", "$t5", "$s2", "next_byte")
+    p.emit("and", "$t6", "$v0", "$s0")
+    p.emit("srl", "$v0", "$v0", 1)
+    p.emit("beq", "$t6", "$zero", "no_xor")
+    p.xor("$v0", "$v0", "$a1", "$t3", "$t4")
+    p.label("no_xor")
+    p.emit("add", "$t5", "$t5", "$s0")
+    p.emit("j", "bit")
+    p.label("next_byte")
+    p.emit("add", "$t0", "$t0", "$s1")
+    p.emit("add", "$t1", "$t1", "$s0")
+    p.emit("j", "byte")
+    p.label("done")
+    p.xor("$v0", "$v0", "$a2", "$t3", "$t4")
+    p.emit("sw", "$v0", "0($t0)")
+    p.epilogue()
+    return p, data, data + [crc], crc
+
+
+def unrolled_sum(n, rng):
+    # array_sum four words at a time: the loads are issued before the adds
+    # that use them, so slow loads can overlap (see --mshrs)
+    groups = (n + 3) // 4
+    data = [rng.randint(0, 1000) for _ in range(n)]
+    total = sum(data)
+
+    p = Program()
+    p.li("$s2", 16)
+    p.li("$a0", 16 * groups)
+    p.label("loop")
+    p.emit("beq", "$t4", "$a0", "done")
+    p.emit("lw", "$t0", "0($t4)")
+    p.emit("lw", "$t1", "4($t4)")
+    p.emit("lw", "$t2", "8($t4)")
+    p.emit("lw", "$t3", "12($t4)")
+    p.emit("add", "$t4", "$t4", "$s2")
+    p.emit("add", "$v0", "$v0", "$t0")
+    p.emit("add", "$v0", "$v0", "$t1")
+    p.emit("add", "$v0", "$v0", "$t2")
+    p.emit("add", "$v0", "$v0", "$t3")
+    p.emit("j", "loop")
+    p.label("done")
+    p.emit("sw", "$v0", "0($t4)")
+    p.epilogue()
+    return p, data, data + [0] * (4 * groups - n) + [total], total
+
+
+# kernel: (generator, default size, largest size that fits in memory)
+KERNELS = {
+    "matmul": (matmul, 6, 180),
+    "memcpy": (memcpy, 500, MEM_SIZE // 2),
+    "list": (linked_list, 300, (MEM_SIZE - 2) // 2),
+    "bsearch": (bsearch, 256, MEM_SIZE // 2),
+    "histogram": (histogram, 500, MEM_SIZE - 16),
+    "bubble_sort": (bubble_sort, 40, MEM_SIZE),
+    "selection_sort": (selection_sort, 60, MEM_SIZE),
+    "crc32": (crc32, 32, MEM_SIZE - 1),
+    "unrolled_sum": (unrolled_sum, 400, MEM_SIZE - 4),
+}
+
+
+
+def write_test(folder, program, memory, expected, v0):
+    os.makedirs(folder, exist_ok = True)
+    with open(folder + "/src", "w") as f:
+        f.write(program.source() + "\n")
+    with open(folder + "/mem", "w") as f:
+        f.write("".join("{}-{}\n".format(i, v) for i, v in enumerate(memory) if v != 0))
+
+    rf = [0] * RF_SIZE
+    rf[REGISTERS.index("$v0")] = v0
+    mem = expected + [0] * (MEM_SIZE - len(expected))
+    with open(folder + "/res", "w") as f:
+        f.write("Register file: \n")
+        for i in range(0, RF_SIZE, 8):
+            f.write(" ".join(map(str, rf[i:i + 8])) + " \n")
+        f.write("\nMemory: \n")
+        for i in range(0, MEM_SIZE, 5000):
+            f.write(" ".join(map(str, mem[i:i + 5000])) + " \n")
+
+
+def generate(kernel, size, seed, folder):
+    generator, default, largest = KERNELS[kernel]
+    size = default if size is None else size
+    if not 1 <= size <= largest:
+        raise SystemExit("{}: size must be between 1 and {}".format(kernel, largest))
+    program, memory, expected, v0 = generator(size, random.Random(seed))
+    write_test(folder or "gen/{}_{}".format(kernel, size), program, memory, expected, v0)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description = "Generate parameterised test kernels.")
+    parser.add_argument("kernel", choices = sorted(KERNELS) + ["all"])
+    parser.add_argument("--size", type = int)
+    parser.add_argument("--seed", type = int, default = 1)
+    parser.add_argument("--out")
+    args = parser.parse_args()
+
+    if args.kernel == "all":
+        for kernel in KERNELS:
+            generate(kernel, None, args.seed, "gen/" + kernel)
+    else:
+        generate(args.kernel, args.size, args.seed, args.out)
@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include "assembler.h"
+#include "batch.h"
+#include "decoupled.h"
+#include "interval.h"
+#include "memory.h"
+#include "number.h"
+#include "simulator.h"
+#include "textload.h"
+#define ll long long
+using namespace std;
+
+/*
+    In-process replacement for checker.py:
+
+        test_runner [--threads=N] [--reps=N] [--baseline=FILE] [--timing]
+                    [--record=FILE] [--decoupled] [--interval=N] [--batch=N]
+                    [--mshrs=N] [DIR...]
+
+    Every DIR holds src, mem and res as checker.py expects them; without
+    DIRs all such directories under basic/, hard/ and gen/ are run. Each
+    test is assembled once and its memory loaded once into a MemoryImage;
+    every (test, simulator) pair then runs on a thread pool against a
+    copy-on-write view of it, and the final register file and memory are
+    compared with res directly instead of through the text dump.
+
+    Every pair also records simulated cycles, instructions and host time,
+    the median of --reps runs with its median absolute deviation. With
+    --baseline the pair fails if its cycles or instructions differ from
+    FILE (proc_sim3 runs with a fixed seed, so its counts are exact too),
+    and with --timing as well if its host time regressed by more than
+    max(3 scaled MADs, 10%, 1 ms) over the baseline median; timing runs use
+    one thread unless --threads is given. --record writes the results as a
+    new baseline. --decoupled runs the decoupled variants of decoupled.h
+    instead of the pipelines; they have to match the same baseline, as do
+    the interval runs of interval.h with --interval, in intervals of N
+    instructions. --batch runs every test as a batch (batch.h) of N copies
+    of its memory, all of which have to end as res says. --mshrs runs
+    proc_sim3 with N non-blocking loads, which may take fewer cycles than
+    the baseline but never more.
+
+    Run from tests/. The exit status is 1 if any pair fails.
+*/
+
+struct Test {
+    string dir;
+    vector<ll> program;
+    shared_ptr<const MemoryImage> memory;
+    vector<ll> rf, mem;     // expected
+    string error;           // set if the test could not be prepared
+};
+
+struct Job {
+    Test* test;
+    int variant;
+    bool passed = false;
+    string detail;
+    ll cycles = 0, instructions = 0;
+    double seconds = 0, mad = 0;     // median host time and its deviation
+};
+
+struct Baseline {
+    ll cycles, instructions;
+    double seconds, mad;
+};
+
+#define SEED 1
+#define REGRESSION_MADS 3.0
+#define REGRESSION_FRACTION 0.10
+#define REGRESSION_SECONDS 0.001
+
+static const Pipeline pipelines[] = {runProcSim1, runProcSim2, runProcSim3};
+static const Pipeline decoupledPipelines[] = {runDecoupledProcSim1, runDecoupledProcSim2, runDecoupledProcSim3};
+static const Pipeline intervalPipelines[] = {runIntervalsProcSim1, runIntervalsProcSim2, runIntervalsProcSim3};
+static const BatchPipeline batchPipelines[] = {runBatchProcSim1, runBatchProcSim2, runBatchProcSim3};
+
+static bool hasFile(const string& path) {
+    return access(path.c_str(), R_OK) == 0;
+}
+
+static vector<string> testDirectories(const string& root) {
+    vector<string> dirs;
+    DIR* d = opendir(root.c_str());
+    if(d == nullptr)
+        return dirs;
+    while(dirent* e = readdir(d)) {
+        string dir = root + "/" + e->d_name;
+        if(e->d_name[0] != '.' && hasFile(dir + "/src") && hasFile(dir + "/mem") && hasFile(dir + "/res"))
+            dirs.push_back(dir);
+    }
+    closedir(d);
+    sort(dirs.begin(), dirs.end());
+    return dirs;
+}
+
+// the numbers after label up to the next letter, as checker.py's regex takes them
+static void numbersAfter(const string& text, const string& label, vector<ll>& out) {
+    size_t pos = text.find(label);
+    if(pos == string::npos)
+        return;
+    const char* p = text.data() + pos + label.size();
+    const char* end = text.data() + text.size();
+    while(p < end) {
+        if(*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t') {
+            p++;
+            continue;
+        }
+        ll value;
+        from_chars_result r = from_chars(p, end, value);
+        if(r.ec != errc())
+            break;
+        out.push_back(value);
+        p = r.ptr;
+    }
+}
+
+static void prepare(Test& test) {
+    string source, res;
+    if(!readWholeFile(test.dir + "/src", source) || !readWholeFile(test.dir + "/res", res)) {
+        test.error = "cannot read src or res";
+        return;
+    }
+    if(!assemble(source, test.program, test.error))
+        return;
+    test.memory = make_shared<const MemoryImage>(test.dir + "/mem");
+    if(!test.memory->valid) {
+        test.error = "cannot load mem";
+        return;
+    }
+    numbersAfter(res, "Register file:", test.rf);
+    numbersAfter(res, "Memory:", test.mem);
+}
+
+static double median(vector<double> v) {
+    sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// empty if result and MEM are what res says, else the first difference
+static string check(const Test& test, const SimResult& result, const Memory& MEM) {
+    if(result.rf != test.rf) {
+        for(size_t i = 0; i < min(result.rf.size(), test.rf.size()); i++)
+            if(result.rf[i] != test.rf[i])
+                return "register " + to_string(i) + " is " + to_string(result.rf[i])
+                        + ", expected " + to_string(test.rf[i]);
+        return "register file has " + to_string(result.rf.size()) + " entries, expected "
+                + to_string(test.rf.size());
+    }
+    size_t words = min(MEM.size, (size_t) MEMORY_SIZE);
+    if(test.mem.size() != words)
+        return "res has " + to_string(test.mem.size()) + " memory words, expected " + to_string(words);
+    for(size_t i = 0; i < words; i++)
+        if(MEM.memory[i] != test.mem[i])
+            return "memory word " + to_string(i) + " is " + to_string(MEM.memory[i])
+                    + ", expected " + to_string(test.mem[i]);
+    return "";
+}
+
+static void run(Job& job, int reps, const Pipeline* pipelines, ll interval, int batch, int mshrs) {
+    Test& test = *job.test;
+    if(test.error != "") {
+        job.detail = test.error;
+        return;
+    }
+    Options options;
+    options.seed = SEED;
+    options.interval = interval;
+    options.mshrs = mshrs;
+    options.threads = 1;    // the pairs already run in parallel
+    HostPerf perf(false);
+    InstructionMemory IMEM(test.program);
+    vector<unique_ptr<Memory>> memories;
+    vector<Memory*> MEM;
+    for(int i = 0; i < max(batch, 1); i++) {
+        memories.push_back(make_unique<Memory>(test.memory));
+        MEM.push_back(memories.back().get());
+    }
+    vector<SimResult> results;
+    vector<double> samples;
+    for(int r = 0; r < reps; r++) {
+        if(r > 0)
+            for(Memory* m : MEM)
+                m->reset();
+        auto start = chrono::steady_clock::now();
+        if(batch > 0)
+            results = batchPipelines[job.variant](options, IMEM, MEM, perf, nullptr);
+        else
+            results = {pipelines[job.variant](options, IMEM, *MEM[0], perf)};
+        samples.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    job.seconds = median(samples);
+    for(double& sample : samples)
+        sample = abs(sample - job.seconds);
+    job.mad = median(samples);
+    job.cycles = results[0].cycles;
+    job.instructions = results[0].instructions;
+
+    for(size_t i = 0; i < results.size(); i++) {
+        job.detail = check(test, results[i], *MEM[i]);
+        if(job.detail == "" && (results[i].cycles != job.cycles || results[i].instructions != job.instructions))
+            job.detail = to_string(results[i].cycles) + " cycles for " + to_string(results[i].instructions)
+                    + " instructions";
+        if(job.detail != "") {
+            if(batch > 0)
+                job.detail = "instance " + to_string(i) + ": " + job.detail;
+            return;
+        }
+    }
+    job.passed = true;
+}
+
+// runs work(i) for i in [0, n) on threads workers
+template<class F>
+static void parallelFor(size_t n, int threads, F work) {
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for(size_t i; (i = next++) < n; )
+            work(i);
+    };
+    vector<thread> pool;
+    for(int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for(thread& t : pool)
+        t.join();
+}
+
+static map<string, Baseline> readBaseline(const string& file) {
+    map<string, Baseline> baseline;
+    ifstream in (file);
+    if(!in) {
+        cerr << "cannot read baseline " << file << endl;
+        exit(1);
+    }
+    string line;
+    while(getline(in, line)) {
+        if(line.empty() || line[0] == '#')
+            continue;
+        istringstream fields (line);
+        string test, binary;
+        Baseline b;
+        if(fields >> test >> binary >> b.cycles >> b.instructions >> b.seconds >> b.mad)
+            baseline[test + " " + binary] = b;
+    }
+    return baseline;
+}
+
+static void writeBaseline(const string& file, const vector<Job>& jobs, int reps) {
+    FILE* out = fopen(file.c_str(), "w");
+    if(out == nullptr) {
+        cerr << "cannot write baseline " << file << endl;
+        exit(1);
+    }
+    fprintf(out, "# test binary cycles instructions host_seconds_median host_seconds_mad\n");
+    fprintf(out, "# host times are from the machine that recorded this file, median of %d runs\n", reps);
+    for(const Job& job : jobs)
+        if(job.passed)
+            fprintf(out, "%s proc_sim%d %lld %lld %.6f %.6f\n", job.test->dir.c_str(), job.variant + 1,
+                    job.cycles, job.instructions, job.seconds, job.mad);
+    fclose(out);
+}
+
+/*
+    Appends to job.detail and fails the job if it moved away from the
+    baseline, or with fewer set only if it took more cycles.
+*/
+static void compareBaseline(Job& job, const map<string, Baseline>& baseline, bool timing, bool fewer) {
+    auto it = baseline.find(job.test->dir + " proc_sim" + to_string(job.variant + 1));
+    if(it == baseline.end()) {
+        if(job.passed)
+            job.detail = "not in the baseline";
+        return;
+    }
+    const Baseline& b = it->second;
+    string changes;
+    if(fewer ? job.cycles > b.cycles : job.cycles != b.cycles)
+        changes += "cycles " + to_string(b.cycles) + " -> " + to_string(job.cycles) + "; ";
+    if(job.instructions != b.instructions)
+        changes += "instructions " + to_string(b.instructions) + " -> " + to_string(job.instructions) + "; ";
+    if(timing) {
+        // 1.4826 MAD estimates the standard deviation of normal noise
+        double noise = 1.4826 * max(b.mad, job.mad);
+        double allowed = max({REGRESSION_MADS * noise, REGRESSION_FRACTION * b.seconds, REGRESSION_SECONDS});
+        if(job.seconds - b.seconds > allowed) {
+            char text[128];
+            snprintf(text, sizeof(text), "host time %.4fs -> %.4fs (allowed +%.4fs); ",
+                     b.seconds, job.seconds, allowed);
+            changes += text;
+        }
+    }
+    if(changes != "") {
+        job.passed = false;
+        job.detail += (job.detail == "" ? "" : "; ") + changes.substr(0, changes.size() - 2);
+    }
+}
+
+static void usage(const char* name) {
+    cerr << "usage: " << name << " [--threads=N] [--reps=N] [--baseline=FILE] [--timing]"
+         << " [--record=FILE] [--decoupled] [--interval=N] [--batch=N] [--mshrs=N] [DIR...]" << endl;
+}
+
+// text as a number into out, raised to at least least
+template<class T>
+static bool atLeast(const string& text, T& out, T least) {
+    if(!number(text, out))
+        return false;
+    out = max(least, out);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 0, reps = 1;
+    bool timing = false, decoupled = false;
+    ll interval = 0;
+    int batch = 0, mshrs = 0;
+    string baselineFile, recordFile;
+    vector<string> dirs;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool ok = true;
+        if(arg.compare(0, 10, "--threads=") == 0)
+            ok = atLeast(arg.substr(10), threads, 1);
+        else if(arg.compare(0, 7, "--reps=") == 0)
+            ok = atLeast(arg.substr(7), reps, 1);
+        else if(arg.compare(0, 11, "--baseline=") == 0)
+            baselineFile = arg.substr(11);
+        else if(arg.compare(0, 9, "--record=") == 0)
+            recordFile = arg.substr(9);
+        else if(arg == "--timing")
+            timing = true;
+        else if(arg == "--decoupled")
+            decoupled = true;
+        else if(arg.compare(0, 11, "--interval=") == 0)
+            ok = atLeast(arg.substr(11), interval, 1LL);
+        else if(arg.compare(0, 8, "--batch=") == 0)
+            ok = atLeast(arg.substr(8), batch, 1);
+        else if(arg.compare(0, 8, "--mshrs=") == 0)
+            ok = atLeast(arg.substr(8), mshrs, 0);
+        else if(arg.compare(0, 2, "--") == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+        else
+            dirs.push_back(arg);
+        if(!ok) {
+            cerr << "not a number in range in " << arg << endl;
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    // timings taken while other pairs run on the same cores are noise
+    if(threads == 0)
+        threads = timing || recordFile != "" ? 1 : max(1u, thread::hardware_concurrency());
+    if(dirs.empty())
+        for(string root : {"basic", "hard", "gen"})
+            for(string& dir : testDirectories(root))
+                dirs.push_back(dir);
+    map<string, Baseline> baseline;
+    if(baselineFile != "")
+        baseline = readBaseline(baselineFile);
+
+    auto start = chrono::steady_clock::now();
+    vector<Test> tests(dirs.size());
+    for(size_t i = 0; i < dirs.size(); i++)
+        tests[i].dir = dirs[i];
+    parallelFor(tests.size(), threads, [&](size_t i) { prepare(tests[i]); });
+
+    vector<Job> jobs;
+    for(Test& test : tests)
+        for(int variant = 0; variant < 3; variant++) {
+            Job job;
+            job.test = &test;
+            job.variant = variant;
+            jobs.push_back(job);
+        }
+    const Pipeline* variants = interval ? intervalPipelines : decoupled ? decoupledPipelines : pipelines;
+    parallelFor(jobs.size(), threads, [&](size_t i) { run(jobs[i], reps, variants, interval, batch, mshrs); });
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int failures = 0;
+    for(Job& job : jobs) {
+        if(baselineFile != "")
+            compareBaseline(job, baseline, timing, mshrs > 0 && job.variant == 2);
+        printf("Test: %s, Binary: proc_sim%d\t%s... cycles %lld, instructions %lld, %.4fs +- %.4fs%s%s\n",
+               job.test->dir.c_str(), job.variant + 1, job.passed ? "Success" : "Failure",
+               job.cycles, job.instructions, job.seconds, job.mad,
+               job.detail == "" ? "" : "\n    ", job.detail.c_str());
+        failures += !job.passed;
+    }
+    printf("%zu passed, %d failed, %zu tests on %d threads in %.3fs\n",
+           jobs.size() - failures, failures, tests.size(), threads, seconds);
+    if(recordFile != "")
+        writeBaseline(recordFile, jobs, reps);
+    return failures ? 1 : 0;
+}